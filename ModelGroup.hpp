@@ -13,6 +13,7 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <functional>
 
 #include "vulkan/vulkan.h"
 
@@ -27,7 +28,10 @@
 
 #include "VulkanDevice.hpp"
 #include "VulkanBuffer.hpp"
+#include "VulkanGrowableBuffer.hpp"
 #include "VulkanTexture.hpp"
+#include "threadpool.hpp"
+#include "trace.hpp"
 
 #if defined(__ANDROID__)
 #include <android/asset_manager.h>
@@ -62,6 +66,14 @@ namespace vks
 			uint32_t modelIndex;
 			uint32_t partIndex;
 		};
+		//one vkCmdDrawIndexed of consecutive instances sharing a model part
+		struct DrawBatch {
+			uint32_t indexCount;
+			uint32_t instanceCount;
+			uint32_t firstIndex;
+			int32_t vertexOffset;
+			uint32_t firstInstance;
+		};
 		struct InstanceData {
 			uint32_t materialIndex = 0;
 			glm::mat4 modelMat = glm::mat4();
@@ -81,6 +93,7 @@ namespace vks
 
 		uint32_t addInstance(uint32_t modelIdx, uint32_t partIdx, std::vector<InstanceData> datas){
 			uint32_t idx = instances.size();
+			drawsVersion++;
 			for (int i = 0; i < datas.size(); i++){
 				instances.push_back({modelIdx,partIdx});
 				instanceDatas.push_back(datas[i]);
@@ -89,12 +102,14 @@ namespace vks
 		}
 		uint32_t addInstance(uint32_t modelIdx, uint32_t partIdx, InstanceData data){
 			uint32_t idx = instances.size();
+			drawsVersion++;
 			instances.push_back({modelIdx,partIdx});
 			instanceDatas.push_back(data);
 			return idx;
 		}
 		uint32_t addInstance(uint32_t modelIdx, uint32_t partIdx,const glm::mat4& modelMat){
 			uint32_t idx = instances.size();
+			drawsVersion++;
 			instances.push_back({modelIdx,partIdx});
 			InstanceData id;
 			id.materialIndex = models[modelIdx].parts[partIdx].materialIdx;
@@ -128,35 +143,77 @@ namespace vks
 		std::vector<Model> models;
 		std::vector<Material> materials;
 
+		//instance and material buffers of one frame in flight, the cpu only writes the slot of the frame being prepared
+		struct FrameBuffers {
+			//grows with the instance count, descriptors using it must be updated when instanceBuff.version changes
+			vks::GrowableBuffer instanceBuff;
+			vks::Buffer materialsBuff;
+			//element ranges [begin, end) changed since this slot was last written
+			size_t instancesDirtyBegin = 0;
+			size_t instancesDirtyEnd = 0;
+			size_t materialsDirtyBegin = 0;
+			size_t materialsDirtyEnd = 0;
+		};
+
 		vks::Buffer vertices;
 		vks::Buffer indices;
-		vks::Buffer instanceBuff;
-		vks::Buffer materialsBuff;
+		std::vector<FrameBuffers> frames;
+		//slot of the frame being prepared (see updateFrame)
+		uint32_t frameIndex = 0;
+		//called when the instance buffer of a slot has been replaced by updateFrame, descriptors using it must be updated before the slot's frame is submitted
+		std::function<void(uint32_t)> onInstanceBufferReplaced;
+		//id of the device frame callback writing each slot when its frame begins, 0 if not registered
+		uint64_t frameCallbackId = 0;
+		//advanced when the recorded draws change: instances added (call invalidateDraws after changing instances directly) or per frame secondaries recorded
+		uint64_t drawsVersion = 0;
 		vks::Texture2DArray texArray;
 
-		ModelGroup (vks::VulkanDevice* dev, VkQueue queue){
+		//framesInFlight defaults to the device's (the example base's -framesinflight)
+		ModelGroup (vks::VulkanDevice* dev, VkQueue queue, uint32_t framesInFlight = 0){
 			device = dev;
 			//layout = vertexLayout;
 			copyQueue = queue;
+			frames.resize((framesInFlight > 0) ? framesInFlight : std::max(dev->framesInFlight, 1u));
 		}
 		~ModelGroup () {
+			if (frameCallbackId != 0)
+				device->removeFrameCallback(frameCallbackId);
+		}
+
+		//buffers of a frame slot, to be bound in the descriptor set used by that slot
+		vks::GrowableBuffer& instanceBuffer (uint32_t slot) { return frames[slot].instanceBuff; }
+		vks::Buffer& materialBuffer (uint32_t slot) { return frames[slot].materialsBuff; }
+		//buffers of the slot being prepared, replace the former instanceBuff/materialsBuff members
+		vks::GrowableBuffer& instanceBuff () { return frames[frameIndex].instanceBuff; }
+		vks::Buffer& materialsBuff () { return frames[frameIndex].materialsBuff; }
+
+		//version of the state command buffers recording the group depend on: the draws and the instance buffer handles
+		//pass it to VulkanExampleBase::addCommandBufferDependency to have them re-recorded when it changes
+		uint64_t commandBufferVersion () const {
+			uint64_t version = drawsVersion;
+			for (auto& frame : frames)
+				version += frame.instanceBuff.version;
+			return version;
 		}
+		//the instances have been changed without addInstance (e.g. removed or moved to another model part)
+		void invalidateDraws () { drawsVersion++; }
 
 		void destroy()
 		{
 			assert(device);
-			if (materialsBuff.size > 0)
-				materialsBuff.destroy();
-			if (instanceBuff.size > 0)
-				instanceBuff.destroy();
-			texArray.destroy();
-			vkDestroyBuffer(device->logicalDevice, vertices.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, vertices.memory, nullptr);
-			if (indices.buffer != VK_NULL_HANDLE)
-			{
-				vkDestroyBuffer(device->logicalDevice, indices.buffer, nullptr);
-				vkFreeMemory(device->logicalDevice, indices.memory, nullptr);
+			if (frameCallbackId != 0) {
+				device->removeFrameCallback(frameCallbackId);
+				frameCallbackId = 0;
+			}
+			for (auto& frame : frames) {
+				if (frame.materialsBuff.size > 0)
+					frame.materialsBuff.destroy();
+				if (frame.instanceBuff.size > 0)
+					frame.instanceBuff.destroy();
 			}
+			texArray.destroy();
+			vertices.destroy();
+			indices.destroy();
 		}
 
 		void prepare()
@@ -225,60 +282,9 @@ namespace vks
 			uint32_t vBufferSize = static_cast<uint32_t>(vertexBuffer.size()) * sizeof(float);
 			uint32_t iBufferSize = static_cast<uint32_t>(indexBuffer.size()) * sizeof(uint32_t);
 
-			// Use staging buffer to move vertex and index buffer to device local memory
-			// Create staging buffers
-			vks::Buffer vertexStaging, indexStaging;
-
-			// Vertex buffer
-			VK_CHECK_RESULT(device->createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-				&vertexStaging,
-				vBufferSize,
-				vertexBuffer.data()));
-
-			// Index buffer
-			VK_CHECK_RESULT(device->createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-				&indexStaging,
-				iBufferSize,
-				indexBuffer.data()));
-
-			// Create device local target buffers
-			// Vertex buffer
-			VK_CHECK_RESULT(device->createBuffer(
-				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				&vertices,
-				vBufferSize));
-
-			// Index buffer
-			VK_CHECK_RESULT(device->createBuffer(
-				VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				&indices,
-				iBufferSize));
-
-			// Copy from staging buffers
-			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-			VkBufferCopy copyRegion{};
-
-			copyRegion.size = vertices.size;
-			vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
-
-			copyRegion.size = indices.size;
-			vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
-
-			device->flushCommandBuffer(copyCmd, copyQueue);
-
-			// Destroy staging resources
-			vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-			vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
-
+			// Create device local buffers, written directly on devices with host visible device local memory, staged otherwise
+			VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertices, vBufferSize, vertexBuffer.data()));
+			VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &indices, iBufferSize, indexBuffer.data()));
 
 			if (mapDic.size()==0)
 				return;
@@ -287,19 +293,40 @@ namespace vks
 
 			buildInstanceBuffer();
 			buildMaterialBuffer();
+
+			//nothing is in flight yet, fill every slot
+			for (uint32_t i = 0; i < frames.size(); i++)
+				updateFrame(i);
+			frameIndex = 0;
+
+			//later changes are written to each slot when its next frame begins (see VulkanDevice::beginFrame)
+			if (frameCallbackId == 0) {
+				frameCallbackId = device->addFrameCallback([this](uint32_t slot) {
+					if (slot < frames.size() && updateFrame(slot) && onInstanceBufferReplaced)
+						onInstanceBufferReplaced(slot);
+				});
+			}
 		}
 
 		void buildCommandBuffer(VkCommandBuffer cmdBuff){
+			std::vector<DrawBatch> draws = collectDraws();
+			recordDraws(cmdBuff, draws, 0, draws.size());
+		}
+
+		//group consecutive instances of the same model part into draw calls
+		std::vector<DrawBatch> collectDraws(){
+			std::vector<DrawBatch> draws;
+			if (instances.empty())
+				return draws;
 			uint32_t modIdx = instances[0].modelIndex;
 			uint32_t partIdx = instances[0].partIndex;
 			uint32_t instCount = 0;
 			uint32_t instOffset = 0;
 
-			for (int i = 0; i < instances.size(); i++){
+			for (uint32_t i = 0; i < instances.size(); i++){
 				if (modIdx != instances[i].modelIndex || partIdx != instances[i].partIndex) {
-					vkCmdDrawIndexed(cmdBuff,	models[modIdx].parts[partIdx].indexCount, instCount,
-												models[modIdx].parts[partIdx].indexBase,
-												models[modIdx].parts[partIdx].vertexBase, instOffset);
+					const ModelPart& part = models[modIdx].parts[partIdx];
+					draws.push_back({part.indexCount, instCount, part.indexBase, (int32_t)part.vertexBase, instOffset});
 
 					modIdx = instances[i].modelIndex;
 					partIdx = instances[i].partIndex;
@@ -308,60 +335,136 @@ namespace vks
 				}
 				instCount++;
 			}
-			if (instCount==0)
+			const ModelPart& part = models[modIdx].parts[partIdx];
+			draws.push_back({part.indexCount, instCount, part.indexBase, (int32_t)part.vertexBase, instOffset});
+			return draws;
+		}
+
+		//record the draws [first, last)
+		void recordDraws(VkCommandBuffer cmdBuff, const std::vector<DrawBatch>& draws, size_t first, size_t last){
+			for (size_t i = first; i < last; i++)
+				vkCmdDrawIndexed(cmdBuff, draws[i].indexCount, draws[i].instanceCount, draws[i].firstIndex, draws[i].vertexOffset, draws[i].firstInstance);
+		}
+
+		//record the draws split in chunks, one secondary command buffer per thread pool worker, and execute them in the primary
+		//the primary's render pass must have been begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS, inheritance gives its render pass, subpass and framebuffer
+		//secondaries don't inherit bound state, bindState is called on the workers to bind the pipeline, descriptor sets, vertex/index buffers, viewport and scissor
+		//the secondaries come from the workers' pools of the frame being prepared (VulkanDevice::createThreadCommandBuffer), which are reset
+		//in bulk when the slot is reused: the primary is only valid for the frame being prepared and must be recorded again for each frame,
+		//which commandBufferVersion reports by changing after each call
+		void buildCommandBufferParallel(VkCommandBuffer primary, const VkCommandBufferInheritanceInfo& inheritance,
+										vks::ThreadPool& threadPool, const std::function<void(VkCommandBuffer)>& bindState,
+										uint32_t minDrawsPerThread = 256){
+			VKS_TRACE_ZONE("ModelGroup::buildCommandBufferParallel");
+			assert(!threadPool.threads.empty());
+
+			std::vector<DrawBatch> draws = collectDraws();
+			if (draws.empty())
 				return;
-			vkCmdDrawIndexed(cmdBuff,	models[modIdx].parts[partIdx].indexCount, instCount,
-										models[modIdx].parts[partIdx].indexBase,
-										models[modIdx].parts[partIdx].vertexBase, instOffset);
+			size_t perThread = std::max(minDrawsPerThread, 1u);
+			size_t chunkCount = (draws.size() + perThread - 1) / perThread;
+			chunkCount = std::max<size_t>(1, std::min(chunkCount, threadPool.threads.size()));
+
+			std::vector<VkCommandBuffer> secondaries(chunkCount);
+			for (size_t t = 0; t < chunkCount; t++) {
+				size_t first = draws.size() * t / chunkCount;
+				size_t last = draws.size() * (t + 1) / chunkCount;
+				VkCommandBuffer* cmdBuff = &secondaries[t];
+				threadPool.threads[t]->addJob([this, cmdBuff, first, last, &draws, &inheritance, &bindState]() {
+					*cmdBuff = device->createThreadCommandBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY, true, &inheritance,
+						VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+					bindState(*cmdBuff);
+					recordDraws(*cmdBuff, draws, first, last);
+					VK_CHECK_RESULT(vkEndCommandBuffer(*cmdBuff));
+				});
+			}
+			threadPool.wait();
+
+			vkCmdExecuteCommands(primary, (uint32_t)secondaries.size(), secondaries.data());
+			//the secondaries are reset with the frame slot, command buffers executing them are stale for the next frame
+			drawsVersion++;
 		}
 
 		void buildMaterialBuffer () {
-			VK_CHECK_RESULT(device->createBuffer(
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				&materialsBuff,
-				sizeof(vks::Material)*256));
-
-			VK_CHECK_RESULT(materialsBuff.map());
+			for (auto& frame : frames) {
+				VK_CHECK_RESULT(device->createBuffer(
+					VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+					&frame.materialsBuff,
+					sizeof(vks::Material)*256));
+
+				VK_CHECK_RESULT(frame.materialsBuff.map());
+			}
 			updateMaterialBuffer();
 		}
+		//create the instance buffers and mark the instances added since the last call for upload
+		//the buffers grow when the frame slots are written, without waiting for the device
 		void buildInstanceBuffer (){
-			if (instanceBuff.size > 0){
-				vkDeviceWaitIdle(device->logicalDevice);
-				instanceBuff.destroy();
+			VkDeviceSize dataSize = instanceDatas.size() * sizeof(InstanceData);
+
+			for (auto& frame : frames) {
+				if (frame.instanceBuff.buffer == VK_NULL_HANDLE){
+					VK_CHECK_RESULT(frame.instanceBuff.create(device,
+						VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+						VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+						std::max<VkDeviceSize>(dataSize, sizeof(InstanceData))));
+				}
+				//instances have been removed, rewrite from the start
+				size_t first = (dataSize < frame.instanceBuff.used) ? 0 : frame.instanceBuff.used / sizeof(InstanceData);
+				markDirty(frame.instancesDirtyBegin, frame.instancesDirtyEnd, first, instanceDatas.size() - first);
 			}
-
-
-			instanceBuff.size = instanceDatas.size() * sizeof(InstanceData);
-
-			VK_CHECK_RESULT(device->createBuffer(
-				VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				&instanceBuff,
-				instanceBuff.size));
-
-			VK_CHECK_RESULT(instanceBuff.map());
-//			VK_CHECK_RESULT(device->createBuffer(
-//				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-//				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-//				&instanceBuff,
-//				instanceBuff.size,
-//				&instanceBuff.memory));
-
-//			device->copyBuffer(&stagingBuff,&instanceBuff, copyQueue);
-			//stagingBuff.destroy();
-			updateInstancesBuffer();
 		}
 
 		void updateInstancesBuffer(){
-			memcpy(instanceBuff.mapped, instanceDatas.data(), instanceDatas.size() * sizeof(InstanceData));
+			updateInstances(0, instanceDatas.size());
+		}
+		//mark the given instances for upload, each frame slot is written by updateFrame when its next frame begins
+		//changes made after the current frame has begun show up from the next frame on
+		void updateInstances(size_t first, size_t count){
+			for (auto& frame : frames)
+				markDirty(frame.instancesDirtyBegin, frame.instancesDirtyEnd, first, count);
 		}
 		void updateMaterialBuffer(){
-			memcpy(materialsBuff.mapped, materials.data(), sizeof(vks::Material)*materials.size());
+			updateMaterials(0, materials.size());
+		}
+		void updateMaterials(size_t first, size_t count){
+			for (auto& frame : frames)
+				markDirty(frame.materialsDirtyBegin, frame.materialsDirtyEnd, first, count);
+		}
+
+		//write the changes pending for a frame slot, called from the device's frame callback once the frame that last used the slot has completed
+		//returns true if the slot's instance buffer has been replaced (descriptors must be updated)
+		bool updateFrame(uint32_t slot){
+			frameIndex = slot;
+			FrameBuffers& frame = frames[slot];
+			if (frame.instanceBuff.buffer == VK_NULL_HANDLE)
+				return false;
+
+			uint32_t version = frame.instanceBuff.version;
+			VkDeviceSize dataSize = instanceDatas.size() * sizeof(InstanceData);
+			frame.instanceBuff.reserve(dataSize);
+			frame.instanceBuff.used = dataSize;
+			if (frame.instancesDirtyEnd > frame.instancesDirtyBegin) {
+				size_t end = std::min(frame.instancesDirtyEnd, instanceDatas.size());
+				if (end > frame.instancesDirtyBegin)
+					frame.instanceBuff.update(frame.instancesDirtyBegin * sizeof(InstanceData), instanceDatas.data() + frame.instancesDirtyBegin,
+						(end - frame.instancesDirtyBegin) * sizeof(InstanceData));
+				frame.instancesDirtyBegin = frame.instancesDirtyEnd = 0;
+			}
+			if (frame.materialsDirtyEnd > frame.materialsDirtyBegin && frame.materialsBuff.mapped) {
+				size_t end = std::min(frame.materialsDirtyEnd, materials.size());
+				if (end > frame.materialsDirtyBegin) {
+					frame.materialsBuff.write(materials.data() + frame.materialsDirtyBegin, end - frame.materialsDirtyBegin, frame.materialsDirtyBegin);
+					VK_CHECK_RESULT(frame.materialsBuff.commit());
+				}
+				frame.materialsDirtyBegin = frame.materialsDirtyEnd = 0;
+			}
+			return version != frame.instanceBuff.version;
 		}
 
 		int addModel(const std::string& filename, const int flags = defaultFlags)
 		{
+			VKS_TRACE_ZONE("Model load");
 			Assimp::Importer Importer;
 			const aiScene* pScene;
 
@@ -511,5 +614,17 @@ namespace vks
 				return -1;
 			}
 		}
+	private:
+		static void markDirty(size_t& begin, size_t& end, size_t first, size_t count){
+			if (count == 0)
+				return;
+			if (end > begin) {
+				begin = std::min(begin, first);
+				end = std::max(end, first + count);
+			} else {
+				begin = first;
+				end = first + count;
+			}
+		}
 	};
 }
@@ -11,9 +11,12 @@
 #pragma once
 
 #include <vector>
+#include <algorithm>
+#include <string.h>
 
 #include "vulkan/vulkan.h"
 #include "VulkanTools.h"
+#include "VulkanMemory.hpp"
 
 namespace vks
 {	
@@ -30,12 +33,19 @@ namespace vks
 		VkDeviceSize size = 0;
 		VkDeviceSize alignment = 0;
 		void* mapped = nullptr;
+		/** @brief Byte offset from the beginning of the buffer that mapped points to */
+		VkDeviceSize mappedOffset = 0;
+		/** @brief Sub-range of a memory block backing this buffer (memory is the block's handle), not set for buffers with their own memory */
+		vks::Allocation allocation;
 
 		/** @brief Usage flags to be filled by external source at buffer creation (to query at some later point) */
 		VkBufferUsageFlags usageFlags;
 		/** @brief Memory propertys flags to be filled by external source at buffer creation (to query at some later point) */
 		VkMemoryPropertyFlags memoryPropertyFlags;
 
+		/** @brief Byte ranges (begin, end) from the beginning of the buffer written through write() or markDirty() since the last commit() */
+		std::vector<std::pair<VkDeviceSize, VkDeviceSize>> dirtyRanges;
+
 		/** 
 		* Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
 		* 
@@ -46,6 +56,18 @@ namespace vks
 		*/
 		VkResult map(VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0)
 		{
+			if (allocation.block)
+			{
+				// Host visible blocks are persistently mapped by the allocator
+				if (allocation.mapped == nullptr)
+				{
+					return VK_ERROR_MEMORY_MAP_FAILED;
+				}
+				mapped = static_cast<uint8_t*>(allocation.mapped) + offset;
+				mappedOffset = offset;
+				return VK_SUCCESS;
+			}
+			mappedOffset = offset;
 			return vkMapMemory(device, memory, offset, size, 0, &mapped);
 		}
 
@@ -58,8 +80,12 @@ namespace vks
 		{
 			if (mapped)
 			{
-				vkUnmapMemory(device, memory);
+				if (!allocation.block)
+				{
+					vkUnmapMemory(device, memory);
+				}
 				mapped = nullptr;
+				mappedOffset = 0;
 			}
 		}
 
@@ -72,7 +98,7 @@ namespace vks
 		*/
 		VkResult bind(VkDeviceSize offset = 0)
 		{
-			return vkBindBufferMemory(device, buffer, memory, offset);
+			return vkBindBufferMemory(device, buffer, memory, allocation.offset + offset);
 		}
 
 		/**
@@ -102,6 +128,110 @@ namespace vks
 			memcpy(mapped, data, size);
 		}
 
+		/**
+		* Copy elements into the mapped buffer and mark the written range dirty
+		*
+		* @param data Pointer to the first element to copy
+		* @param count Number of elements to copy
+		* @param firstElement (Optional) Index of the first element to write, counted in elements of T from the beginning of the buffer (not of the mapped range)
+		*
+		* @note The written range is made visible to the device by the next commit()
+		*/
+		template<typename T>
+		void write(const T *data, size_t count, size_t firstElement = 0)
+		{
+			assert(mapped);
+			VkDeviceSize offset = firstElement * sizeof(T);
+			VkDeviceSize size = count * sizeof(T);
+			assert((offset >= mappedOffset) && (offset + size <= this->size));
+			memcpy(static_cast<uint8_t*>(mapped) + (offset - mappedOffset), data, size);
+			markDirty(offset, size);
+		}
+
+		/**
+		* Mark a range written through mapped by the caller, to be flushed by the next commit()
+		*
+		* @param offset Byte offset from the beginning of the buffer (add mappedOffset to offsets into mapped)
+		* @param size Size of the written range
+		*/
+		void markDirty(VkDeviceSize offset, VkDeviceSize size)
+		{
+			if (size > 0)
+			{
+				dirtyRanges.push_back({ offset, offset + size });
+			}
+		}
+
+		/**
+		* Flush the ranges written since the last commit
+		*
+		* Dirty ranges are merged and widened to the non-coherent atom size before being flushed in a single call,
+		* nothing is flushed for host coherent memory.
+		*
+		* @return VkResult of the flush call
+		*/
+		VkResult commit()
+		{
+			if (dirtyRanges.empty())
+			{
+				return VK_SUCCESS;
+			}
+
+			VkMemoryPropertyFlags propertyFlags = memoryPropertyFlags;
+			VkDeviceSize atomSize = 1;
+			VkDeviceSize memoryEnd = allocation.offset + allocation.size;
+			if (allocation.block)
+			{
+				propertyFlags = allocation.block->allocator->memoryProperties.memoryTypes[allocation.memoryTypeIndex].propertyFlags;
+				atomSize = allocation.block->allocator->nonCoherentAtomSize;
+			}
+			if (propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)
+			{
+				dirtyRanges.clear();
+				return VK_SUCCESS;
+			}
+			if (!allocation.block)
+			{
+				// Without the allocator the atom size and memory bounds are unknown, flush everything
+				dirtyRanges.clear();
+				return flush();
+			}
+
+			// Align to atoms of the memory object, the allocator keeps non-coherent allocations atom aligned
+			for (auto &range : dirtyRanges)
+			{
+				range.first = ((allocation.offset + range.first) / atomSize) * atomSize;
+				range.second = std::min(vks::MemoryBlock::alignUp(allocation.offset + range.second, atomSize), memoryEnd);
+			}
+			std::sort(dirtyRanges.begin(), dirtyRanges.end());
+
+			std::vector<VkMappedMemoryRange> mappedRanges;
+			VkDeviceSize begin = dirtyRanges[0].first;
+			VkDeviceSize end = dirtyRanges[0].second;
+			for (size_t i = 1; i <= dirtyRanges.size(); i++)
+			{
+				if ((i < dirtyRanges.size()) && (dirtyRanges[i].first <= end))
+				{
+					end = std::max(end, dirtyRanges[i].second);
+					continue;
+				}
+				VkMappedMemoryRange mappedRange = {};
+				mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+				mappedRange.memory = memory;
+				mappedRange.offset = begin;
+				mappedRange.size = end - begin;
+				mappedRanges.push_back(mappedRange);
+				if (i < dirtyRanges.size())
+				{
+					begin = dirtyRanges[i].first;
+					end = dirtyRanges[i].second;
+				}
+			}
+			dirtyRanges.clear();
+
+			return vkFlushMappedMemoryRanges(device, static_cast<uint32_t>(mappedRanges.size()), mappedRanges.data());
+		}
+
 		/** 
 		* Flush a memory range of the buffer to make it visible to the device
 		*
@@ -117,8 +247,8 @@ namespace vks
 			VkMappedMemoryRange mappedRange = {};
 			mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 			mappedRange.memory = memory;
-			mappedRange.offset = offset;
-			mappedRange.size = size;
+			mappedRange.offset = allocation.offset + offset;
+			mappedRange.size = ((size == VK_WHOLE_SIZE) && allocation.block) ? allocation.size - offset : size;
 			return vkFlushMappedMemoryRanges(device, 1, &mappedRange);
 		}
 
@@ -137,24 +267,35 @@ namespace vks
 			VkMappedMemoryRange mappedRange = {};
 			mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
 			mappedRange.memory = memory;
-			mappedRange.offset = offset;
-			mappedRange.size = size;
+			mappedRange.offset = allocation.offset + offset;
+			mappedRange.size = ((size == VK_WHOLE_SIZE) && allocation.block) ? allocation.size - offset : size;
 			return vkInvalidateMappedMemoryRanges(device, 1, &mappedRange);
 		}
 
 		/** 
 		* Release all Vulkan resources held by this buffer
+		*
+		* @note Sub-allocated memory is given back to its memory block
 		*/
 		void destroy()
 		{
 			if (buffer)
 			{
 				vkDestroyBuffer(device, buffer, nullptr);
+				buffer = VK_NULL_HANDLE;
+			}
+			if (allocation.block)
+			{
+				allocation.block->allocator->free(allocation);
 			}
-			if (memory)
+			else if (memory)
 			{
 				vkFreeMemory(device, memory, nullptr);
 			}
+			memory = VK_NULL_HANDLE;
+			mapped = nullptr;
+			mappedOffset = 0;
+			dirtyRanges.clear();
 		}
 
 	};
@@ -13,9 +13,19 @@
 #include <exception>
 #include <assert.h>
 #include <algorithm>
+#include <unordered_map>
+#include <map>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <functional>
+#include <memory>
 #include "vulkan/vulkan.h"
 #include "VulkanTools.h"
 #include "VulkanBuffer.hpp"
+#include "VulkanMemory.hpp"
+#include "VulkanStaging.hpp"
+#include "VulkanProfiler.hpp"
 
 namespace vks
 {	
@@ -33,16 +43,89 @@ namespace vks
 		VkPhysicalDeviceFeatures enabledFeatures;
 		/** @brief Memory types and heaps of the physical device */
 		VkPhysicalDeviceMemoryProperties memoryProperties;
+		/** @brief Bitmask of the memory types that are both device local and host visible (UMA devices, resizable BAR) */
+		uint32_t hostVisibleDeviceLocalMemoryTypes = 0;
+		/** @brief Write static buffers directly into device local host visible memory if available (see createDeviceLocalBuffer), staging is used otherwise */
+		bool directUploads = true;
 		/** @brief Queue family properties of the physical device */
 		std::vector<VkQueueFamilyProperties> queueFamilyProperties;
 		/** @brief List of extensions supported by the device */
 		std::vector<std::string> supportedExtensions;
 
+		/** @brief Sub-allocator for buffer and image memory, created with the logical device */
+		vks::MemoryAllocator *memoryAllocator = nullptr;
+		/** @brief Shared upload ring used by the asset loaders, created on first use (see getStagingRing) */
+		vks::StagingRing *stagingRing = nullptr;
+		/** @brief Upload ring on the transfer queue for asynchronous uploads, only created if the transfer family differs from the graphics one (see getTransferRing) */
+		vks::StagingRing *transferRing = nullptr;
+		/** @brief Size of the staging rings in bytes */
+		VkDeviceSize stagingRingSize = 64 * 1024 * 1024;
+
+		/** @brief Queue of the transfer family, same as the graphics queue if the device has no separate transfer family */
+		VkQueue transferQueue = VK_NULL_HANDLE;
+
 		/** @brief Default command pool for the graphics queue family index */
 		VkCommandPool commandPool = VK_NULL_HANDLE;
+		/** @brief Primary command buffers of the default pool released by flushCommandBuffer, reused by createCommandBuffer */
+		std::vector<VkCommandBuffer> freeCommandBuffers;
+		/** @brief Unsignaled fences reused by flushCommandBuffer */
+		std::vector<VkFence> freeFences;
+
+		/** @brief Command buffer ended by flushCommandBuffer and waiting to be submitted */
+		struct PendingFlush
+		{
+			VkCommandBuffer commandBuffer;
+			VkQueue queue;
+			bool free;
+		};
+		/** @brief Flushes collected while deferred flushing is active (see beginDeferredFlush) */
+		std::vector<PendingFlush> pendingFlushes;
+		/** @brief Nesting depth of beginDeferredFlush calls */
+		uint32_t deferredFlushDepth = 0;
+
+		/** @brief Serial of the frame currently being recorded, advanced by endFrame */
+		uint64_t frameSerial = 1;
+		/** @brief Serial of the last frame whose commands have finished executing on the device */
+		uint64_t completedFrameSerial = 0;
+		/** @brief Fences signaled at the end of each submitted frame, with the serial of that frame */
+		std::deque<std::pair<uint64_t, VkFence>> frameFences;
+		/** @brief Buffers replaced while submitted frames may still read them, with the serial of the last frame that could use them */
+		std::deque<std::pair<uint64_t, vks::Buffer>> retiredBuffers;
+		/** @brief Release functions with the frame serial they were retired in (see retire) */
+		std::deque<std::pair<uint64_t, std::function<void()>>> retiredObjects;
+		/** @brief Number of frames the application keeps in flight, resources written by the cpu each frame are kept once per frame slot (set by the example base) */
+		uint32_t framesInFlight = 2;
+		/** @brief Frame slot being prepared, set by beginFrame */
+		uint32_t frameIndex = 0;
+		/** @brief Graphics command pool owned by one thread for one frame slot, with the command buffers allocated from it */
+		struct ThreadCommandPool
+		{
+			VkCommandPool pool = VK_NULL_HANDLE;
+			/** @brief Allocated command buffers per level (primary, secondary), reused after each reset */
+			std::vector<VkCommandBuffer> commandBuffers[2];
+			/** @brief Number of command buffers per level handed out since the last reset */
+			uint32_t used[2] = { 0, 0 };
+		};
+		/** @brief Per thread command pools, one per frame slot (see getThreadCommandPool), reset in bulk by beginFrame */
+		std::unordered_map<std::thread::id, std::vector<ThreadCommandPool>> threadCommandPools;
+		std::mutex threadCommandPoolsMutex;
+		/** @brief Functions called by beginFrame, by id (see addFrameCallback) */
+		std::map<uint64_t, std::function<void(uint32_t)>> frameCallbacks;
+		uint64_t nextFrameCallbackId = 1;
+
+		/** @brief Locks of the queues used by the application, VkQueue is externally synchronized and loader threads submit uploads (see queueMutex) */
+		std::unordered_map<VkQueue, std::unique_ptr<std::mutex>> queueMutexes;
+		std::mutex queueMutexesMutex;
 
 		/** @brief Set to true when the debug marker extension is detected */
 		bool enableDebugMarkers = false;
+		/** @brief Gpu profiler measuring named scopes of the frame command buffers, nullptr if profiling is disabled (owned by the application) */
+		vks::GpuProfiler *profiler = nullptr;
+
+		/** @brief Set to true when VK_EXT_memory_budget has been enabled, heap budgets are then read by updateMemoryBudget */
+		bool enableMemoryBudget = false;
+		/** @brief Instance level function required for the memory budget query, to be set before device creation (needs VK_KHR_get_physical_device_properties2) */
+		PFN_vkGetPhysicalDeviceMemoryProperties2KHR getPhysicalDeviceMemoryProperties2 = nullptr;
 
 		/** @brief Contains queue family indices */
 		struct
@@ -72,6 +155,14 @@ namespace vks
 			vkGetPhysicalDeviceFeatures(physicalDevice, &features);
 			// Memory properties are used regularly for creating all kinds of buffers
 			vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+			for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+			{
+				const VkMemoryPropertyFlags directFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+				if ((memoryProperties.memoryTypes[i].propertyFlags & directFlags) == directFlags)
+				{
+					hostVisibleDeviceLocalMemoryTypes |= (1 << i);
+				}
+			}
 			// Queue family properties, used for setting up requested queues upon device creation
 			uint32_t queueFamilyCount;
 			vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
@@ -102,10 +193,44 @@ namespace vks
 		*/
 		~VulkanDevice()
 		{
+			// Resources released during teardown must not report budget changes to the application
+			if (memoryAllocator)
+			{
+				memoryAllocator->budgetCallback = nullptr;
+			}
+			for (auto &frameFence : frameFences)
+			{
+				vkWaitForFences(logicalDevice, 1, &frameFence.second, VK_TRUE, DEFAULT_FENCE_TIMEOUT);
+				vkDestroyFence(logicalDevice, frameFence.second, nullptr);
+			}
+			releaseRetired();
+			for (auto fence : freeFences)
+			{
+				vkDestroyFence(logicalDevice, fence, nullptr);
+			}
+			for (auto &threadPools : threadCommandPools)
+			{
+				for (auto &threadPool : threadPools.second)
+				{
+					vkDestroyCommandPool(logicalDevice, threadPool.pool, nullptr);
+				}
+			}
 			if (commandPool)
 			{
 				vkDestroyCommandPool(logicalDevice, commandPool, nullptr);
 			}
+			if (transferRing)
+			{
+				delete transferRing;
+			}
+			if (stagingRing)
+			{
+				delete stagingRing;
+			}
+			if (memoryAllocator)
+			{
+				delete memoryAllocator;
+			}
 			if (logicalDevice)
 			{
 				vkDestroyDevice(logicalDevice, nullptr);
@@ -210,6 +335,18 @@ namespace vks
 				}
 			}
 
+			// Graphics and compute families support transfers even if they don't report the transfer bit
+			if (queueFlags & VK_QUEUE_TRANSFER_BIT)
+			{
+				for (uint32_t i = 0; i < static_cast<uint32_t>(queueFamilyProperties.size()); i++)
+				{
+					if (queueFamilyProperties[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))
+					{
+						return i;
+					}
+				}
+			}
+
 #if defined(__ANDROID__)
 			//todo : Exceptions are disabled by default on Android (need to add LOCAL_CPP_FEATURES += exceptions to Android.mk), so for now just return zero
 			return 0;
@@ -223,11 +360,11 @@ namespace vks
 		*
 		* @param enabledFeatures Can be used to enable certain features upon device creation
 		* @param useSwapChain Set to false for headless rendering to omit the swapchain device extensions
-		* @param requestedQueueTypes Bit flags specifying the queue types to be requested from the device  
+		* @param requestedQueueTypes Bit flags specifying the queue types to be requested from the device (a dedicated transfer-only family is picked up for asynchronous uploads when present)
 		*
 		* @return VkResult of the device creation call
 		*/
-		VkResult createLogicalDevice(VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char*> enabledExtensions, bool useSwapChain = true, VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT)
+		VkResult createLogicalDevice(VkPhysicalDeviceFeatures enabledFeatures, std::vector<const char*> enabledExtensions, bool useSwapChain = true, VkQueueFlags requestedQueueTypes = VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT | VK_QUEUE_TRANSFER_BIT)
 		{			
 			// Desired queues need to be requested upon logical device creation
 			// Due to differing queue family configurations of Vulkan implementations this can be a bit tricky, especially if the application
@@ -319,6 +456,15 @@ namespace vks
 				enableDebugMarkers = true;
 			}
 
+#if defined(VK_EXT_memory_budget)
+			// Enable the memory budget extension if present, so heap budgets reflect other processes and the driver
+			if (getPhysicalDeviceMemoryProperties2 && extensionSupported(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME))
+			{
+				deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+				enableMemoryBudget = true;
+			}
+#endif
+
 			if (deviceExtensions.size() > 0)
 			{
 				deviceCreateInfo.enabledExtensionCount = (uint32_t)deviceExtensions.size();
@@ -331,6 +477,11 @@ namespace vks
 			{
 				// Create a default command pool for graphics command buffers
 				commandPool = createCommandPool(queueFamilyIndices.graphics);
+				// Buffers and images share large memory blocks instead of allocating memory per resource
+				memoryAllocator = new vks::MemoryAllocator(logicalDevice, memoryProperties, properties.limits);
+				updateMemoryBudget();
+				// Queue used by the asynchronous uploads
+				vkGetDeviceQueue(logicalDevice, queueFamilyIndices.transfer, 0, &transferQueue);
 			}
 
 			this->enabledFeatures = enabledFeatures;
@@ -349,6 +500,8 @@ namespace vks
 		* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
 		*
 		* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
+		*
+		* @note The memory is a dedicated allocation owned by the caller (to be released with vkFreeMemory), use the vks::Allocation overload to sub-allocate
 		*/
 		VkResult createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, VkDeviceMemory *memory, void *data = nullptr)
 		{
@@ -409,17 +562,16 @@ namespace vks
 			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
 			VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
 
-			// Create the memory backing up the buffer handle
+			// Sub-allocate the memory backing up the buffer handle from a shared block
 			VkMemoryRequirements memReqs;
-			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
 			vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
-			memAlloc.allocationSize = memReqs.size;
 			// Find a memory type index that fits the properties of the buffer
-			memAlloc.memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
-			VK_CHECK_RESULT(vkAllocateMemory(logicalDevice, &memAlloc, nullptr, &buffer->memory));
+			uint32_t memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
+			VK_CHECK_RESULT(memoryAllocator->allocate(memReqs, memoryTypeIndex, vks::AllocationType::Linear, &buffer->allocation, bufferCategory(usageFlags)));
+			buffer->memory = buffer->allocation.memory;
 
 			buffer->alignment = memReqs.alignment;
-			buffer->size = memAlloc.allocationSize;
+			buffer->size = memReqs.size;
 			buffer->usageFlags = usageFlags;
 			buffer->memoryPropertyFlags = memoryPropertyFlags;
 
@@ -428,6 +580,10 @@ namespace vks
 			{
 				VK_CHECK_RESULT(buffer->map());
 				memcpy(buffer->mapped, data, size);
+				if ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
+				{
+					buffer->flush();
+				}
 				buffer->unmap();
 			}
 
@@ -438,6 +594,187 @@ namespace vks
 			return buffer->bind();
 		}
 
+		/**
+		* Create a buffer on the device backed by a sub-allocated memory range
+		*
+		* @param usageFlags Usage flag bitmask for the buffer (i.e. index, vertex, uniform buffer)
+		* @param memoryPropertyFlags Memory properties for this buffer (i.e. device local, host visible, coherent)
+		* @param size Size of the buffer in byes
+		* @param buffer Pointer to the buffer handle acquired by the function
+		* @param allocation Pointer to the memory range acquired by the function (release with freeMemory)
+		* @param data Pointer to the data that should be copied to the buffer after creation (optional, if not set, no data is copied over)
+		*
+		* @return VK_SUCCESS if buffer handle and memory have been created and (optionally passed) data has been copied
+		*/
+		VkResult createBuffer(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize size, VkBuffer *buffer, vks::Allocation *allocation, void *data = nullptr)
+		{
+			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
+			bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, buffer));
+
+			VkMemoryRequirements memReqs;
+			vkGetBufferMemoryRequirements(logicalDevice, *buffer, &memReqs);
+			VK_CHECK_RESULT(memoryAllocator->allocate(memReqs, getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags), vks::AllocationType::Linear, allocation, bufferCategory(usageFlags)));
+
+			if (data != nullptr)
+			{
+				assert(allocation->mapped);
+				memcpy(allocation->mapped, data, size);
+				if ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
+				{
+					VkMappedMemoryRange mappedRange = vks::initializers::mappedMemoryRange();
+					mappedRange.memory = allocation->memory;
+					mappedRange.offset = allocation->offset;
+					mappedRange.size = allocation->size;
+					vkFlushMappedMemoryRanges(logicalDevice, 1, &mappedRange);
+				}
+			}
+
+			return vkBindBufferMemory(logicalDevice, *buffer, allocation->memory, allocation->offset);
+		}
+
+		/**
+		* Create a device local buffer filled with static data
+		*
+		* @param usageFlags Usage flag bitmask for the buffer (i.e. index, vertex buffer), transfer destination usage is added
+		* @param buffer Pointer to a vk::Vulkan buffer object
+		* @param size Size of the buffer in bytes
+		* @param data Pointer to the data that is copied to the buffer
+		*
+		* @note If a device local memory type is also host visible and its heap has room left, the data is written directly into the buffer.
+		* Otherwise it is copied through the staging ring, the copy is then submitted with the next batch of the ring.
+		*
+		* @return VK_SUCCESS if buffer handle and memory have been created and the data has been written or staged
+		*/
+		VkResult createDeviceLocalBuffer(VkBufferUsageFlags usageFlags, vks::Buffer *buffer, VkDeviceSize size, const void *data)
+		{
+			buffer->device = logicalDevice;
+
+			// Keep the transfer destination usage so the memory type bits do not depend on the path taken
+			usageFlags |= VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(usageFlags, size);
+			VK_CHECK_RESULT(vkCreateBuffer(logicalDevice, &bufferCreateInfo, nullptr, &buffer->buffer));
+
+			VkMemoryRequirements memReqs;
+			vkGetBufferMemoryRequirements(logicalDevice, buffer->buffer, &memReqs);
+
+			VkMemoryPropertyFlags memoryPropertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+			uint32_t memoryTypeIndex = 0;
+			uint32_t directTypeBits = memReqs.memoryTypeBits & hostVisibleDeviceLocalMemoryTypes;
+			bool direct = false;
+			if (directUploads && (directTypeBits != 0))
+			{
+				memoryTypeIndex = getMemoryType(directTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+				// Small host visible device local heaps (resizable BAR windows) are not filled up with static data
+				direct = memoryAllocator->fitsBudget(memoryProperties.memoryTypes[memoryTypeIndex].heapIndex, memReqs.size);
+			}
+			if (direct)
+			{
+				memoryPropertyFlags = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+			}
+			else
+			{
+				memoryTypeIndex = getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags);
+			}
+			VK_CHECK_RESULT(memoryAllocator->allocate(memReqs, memoryTypeIndex, vks::AllocationType::Linear, &buffer->allocation, vks::MemoryCategory::Buffer));
+			buffer->memory = buffer->allocation.memory;
+
+			buffer->alignment = memReqs.alignment;
+			buffer->size = memReqs.size;
+			buffer->usageFlags = usageFlags;
+			buffer->memoryPropertyFlags = memoryPropertyFlags;
+			buffer->setupDescriptor();
+			VK_CHECK_RESULT(buffer->bind());
+
+			if (direct)
+			{
+				// Host visible blocks are persistently mapped by the allocator
+				assert(buffer->allocation.mapped);
+				memcpy(buffer->allocation.mapped, data, size);
+				if ((memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT) == 0)
+				{
+					VK_CHECK_RESULT(buffer->flush());
+				}
+			}
+			else
+			{
+				getStagingRing()->copyToBuffer(data, size, buffer->buffer);
+			}
+
+			return VK_SUCCESS;
+		}
+
+		/**
+		* Sub-allocate memory for an image and bind it
+		*
+		* @param image Image to allocate the memory for
+		* @param memoryPropertyFlags Memory properties for the image (i.e. device local, host visible)
+		* @param allocation Pointer to the memory range acquired by the function (release with freeMemory)
+		* @param tiling (Optional) Tiling the image has been created with, linear images may share granularity pages with buffers (Defaults to VK_IMAGE_TILING_OPTIMAL)
+		* @param category (Optional) Kind of image, for memory accounting (Defaults to vks::MemoryCategory::Texture)
+		*
+		* @return VkResult of the bind call
+		*/
+		VkResult allocateImageMemory(VkImage image, VkMemoryPropertyFlags memoryPropertyFlags, vks::Allocation *allocation, VkImageTiling tiling = VK_IMAGE_TILING_OPTIMAL, vks::MemoryCategory category = vks::MemoryCategory::Texture)
+		{
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(logicalDevice, image, &memReqs);
+			vks::AllocationType type = (tiling == VK_IMAGE_TILING_LINEAR) ? vks::AllocationType::Linear : vks::AllocationType::Optimal;
+			VK_CHECK_RESULT(memoryAllocator->allocate(memReqs, getMemoryType(memReqs.memoryTypeBits, memoryPropertyFlags), type, allocation, category));
+			return vkBindImageMemory(logicalDevice, image, allocation->memory, allocation->offset);
+		}
+
+		/** @brief Accounting category of a buffer, buffers only used as copy source are staging memory */
+		vks::MemoryCategory bufferCategory(VkBufferUsageFlags usageFlags)
+		{
+			return (usageFlags == VK_BUFFER_USAGE_TRANSFER_SRC_BIT) ? vks::MemoryCategory::Staging : vks::MemoryCategory::Buffer;
+		}
+
+		/**
+		* Read the current heap budgets from VK_EXT_memory_budget and pass them to the allocator
+		*
+		* @return True if the budgets could be read, false if the extension is not enabled (heap sizes are used as budgets then)
+		*
+		* @note Cheap enough to be called once per frame, the allocator calls its budget callback when a heap crosses its threshold
+		*/
+		bool updateMemoryBudget()
+		{
+#if defined(VK_EXT_memory_budget)
+			if (!enableMemoryBudget || !memoryAllocator)
+			{
+				return false;
+			}
+
+			VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+			budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+			VkPhysicalDeviceMemoryProperties2KHR memoryProperties2 = {};
+			memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2_KHR;
+			memoryProperties2.pNext = &budgetProperties;
+			getPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties2);
+
+			for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+			{
+				// Heap usage reported by the driver includes our own blocks
+				VkDeviceSize ownUsage = memoryAllocator->getHeapUsage(i);
+				VkDeviceSize externalUsage = (budgetProperties.heapUsage[i] > ownUsage) ? budgetProperties.heapUsage[i] - ownUsage : 0;
+				memoryAllocator->setHeapBudget(i, budgetProperties.heapBudget[i], externalUsage);
+			}
+			return true;
+#else
+			return false;
+#endif
+		}
+
+		/**
+		* Give a sub-allocated memory range back to its memory block
+		*
+		* @param allocation Allocation to release, reset to an empty allocation
+		*/
+		void freeMemory(vks::Allocation &allocation)
+		{
+			memoryAllocator->free(allocation);
+		}
+
 		/**
 		* Copy buffer data from src to dst using VkCmdCopyBuffer
 		* 
@@ -496,13 +833,23 @@ namespace vks
 		* @param (Optional) begin If true, recording on the new command buffer will be started (vkBeginCommandBuffer) (Defaults to false)
 		*
 		* @return A handle to the allocated command buffer
+		*
+		* @note Primary command buffers released by flushCommandBuffer are reused instead of allocating new ones
+		* @note Uses the shared default pool and must only be called from one thread, workers use createThreadCommandBuffer
 		*/
 		VkCommandBuffer createCommandBuffer(VkCommandBufferLevel level, bool begin = false)
 		{
-			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, level, 1);
-
 			VkCommandBuffer cmdBuffer;
-			VK_CHECK_RESULT(vkAllocateCommandBuffers(logicalDevice, &cmdBufAllocateInfo, &cmdBuffer));
+			if ((level == VK_COMMAND_BUFFER_LEVEL_PRIMARY) && !freeCommandBuffers.empty())
+			{
+				cmdBuffer = freeCommandBuffers.back();
+				freeCommandBuffers.pop_back();
+			}
+			else
+			{
+				VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, level, 1);
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(logicalDevice, &cmdBufAllocateInfo, &cmdBuffer));
+			}
 
 			// If requested, also start recording for the new command buffer
 			if (begin)
@@ -519,10 +866,11 @@ namespace vks
 		*
 		* @param commandBuffer Command buffer to flush
 		* @param queue Queue to submit the command buffer to 
-		* @param free (Optional) Free the command buffer once it has been submitted (Defaults to true)
+		* @param free (Optional) Release the command buffer once it has been executed (Defaults to true), it is recycled by createCommandBuffer
 		*
 		* @note The queue that the command buffer is submitted to must be from the same family index as the pool it was allocated from
-		* @note Uses a fence to ensure command buffer has finished executing
+		* @note Uses a pooled fence to ensure command buffer has finished executing
+		* @note Between beginDeferredFlush and endDeferredFlush the command buffer is only ended, it is submitted and waited for by the outermost endDeferredFlush
 		*/
 		void flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free = true)
 		{
@@ -533,26 +881,599 @@ namespace vks
 
 			VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 
-			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
-			submitInfo.commandBufferCount = 1;
-			submitInfo.pCommandBuffers = &commandBuffer;
+			pendingFlushes.push_back({ commandBuffer, queue, free });
+			if (deferredFlushDepth == 0)
+			{
+				submitPendingFlushes();
+			}
+		}
+
+		/**
+		* Start collecting flushed command buffers instead of submitting each of them
+		*
+		* @note Calls can be nested, only the outermost endDeferredFlush submits the collected command buffers
+		* @note Resources read by the collected command buffers (e.g. blit or staging sources) must be released with releaseAfterFlush instead of being destroyed by the caller
+		* @note The outermost endDeferredFlush must be called before the frame is ended (see endFrame)
+		*/
+		void beginDeferredFlush()
+		{
+			deferredFlushDepth++;
+		}
+
+		/**
+		* Close a deferred flush scope, the outermost one submits the command buffers collected since beginDeferredFlush with one vkQueueSubmit per queue and a single wait
+		*
+		* @note Command buffers are submitted in flush order, those for different queues must not depend on each other
+		* @note An inner call does not submit anything, the flushed command buffers have not been executed when it returns
+		*/
+		void endDeferredFlush()
+		{
+			assert(deferredFlushDepth > 0);
+			if (--deferredFlushDepth == 0)
+			{
+				submitPendingFlushes();
+			}
+		}
+
+		/**
+		* Release resources read by flushed command buffers (e.g. blit or staging sources)
+		*
+		* @param release Function destroying the resources
+		*
+		* @note Outside of a deferred flush scope the flushed commands have already finished and release is called right away,
+		* otherwise it is handed to the frame serial retire queue (see retire) as the commands are only submitted by the outermost endDeferredFlush
+		*/
+		void releaseAfterFlush(std::function<void()> release)
+		{
+			if (deferredFlushDepth > 0)
+			{
+				retire(std::move(release));
+			}
+			else
+			{
+				release();
+			}
+		}
+
+		/** @brief Destroy a buffer read by flushed command buffers, reset to an empty buffer by the call (see releaseAfterFlush) */
+		void releaseAfterFlush(vks::Buffer &buffer)
+		{
+			if (deferredFlushDepth > 0)
+			{
+				retireBuffer(buffer);
+			}
+			else
+			{
+				buffer.destroy();
+			}
+		}
+
+		/**
+		* Get the graphics command pool of the calling thread for a frame slot
+		*
+		* @param slot Frame slot, lower than framesInFlight
+		*
+		* @return Pool that is only used by the calling thread, created on first use
+		*
+		* @note Command pools are externally synchronized, the returned pool must not be handed to other threads
+		*/
+		ThreadCommandPool *getThreadCommandPool(uint32_t slot)
+		{
+			std::lock_guard<std::mutex> lock(threadCommandPoolsMutex);
+			std::vector<ThreadCommandPool> &threadPools = threadCommandPools[std::this_thread::get_id()];
+			if (threadPools.size() < framesInFlight)
+			{
+				size_t first = threadPools.size();
+				threadPools.resize(framesInFlight);
+				for (size_t i = first; i < threadPools.size(); i++)
+				{
+					threadPools[i].pool = createCommandPool(queueFamilyIndices.graphics, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT);
+				}
+			}
+			assert(slot < threadPools.size());
+			// Map nodes are stable, the pool can be used after the lock is released
+			return &threadPools[slot];
+		}
+
+		/**
+		* Get a command buffer from the calling thread's pool for the frame being prepared, safe to call from several threads at once
+		*
+		* @param level Level of the command buffer (primary or secondary)
+		* @param (Optional) begin If true, recording on the command buffer will be started (vkBeginCommandBuffer) (Defaults to false)
+		* @param (Optional) inheritance Inheritance info, required to begin secondary command buffers (Defaults to nullptr)
+		* @param (Optional) usageFlags Usage flags to begin the command buffer with, e.g. VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT (Defaults to VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)
+		*
+		* @return Command buffer valid until the frame slot is reset by the next beginFrame for it
+		*
+		* @note Command buffers are not freed individually, their pools are reset in bulk once the slot's frame has completed
+		*/
+		VkCommandBuffer createThreadCommandBuffer(VkCommandBufferLevel level, bool begin = false, const VkCommandBufferInheritanceInfo *inheritance = nullptr, VkCommandBufferUsageFlags usageFlags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT)
+		{
+			ThreadCommandPool *threadPool = getThreadCommandPool(frameIndex);
+			std::vector<VkCommandBuffer> &commandBuffers = threadPool->commandBuffers[level];
+			uint32_t &used = threadPool->used[level];
+
+			if (used == commandBuffers.size())
+			{
+				VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(threadPool->pool, level, 1);
+				VkCommandBuffer cmdBuffer;
+				VK_CHECK_RESULT(vkAllocateCommandBuffers(logicalDevice, &cmdBufAllocateInfo, &cmdBuffer));
+				commandBuffers.push_back(cmdBuffer);
+			}
+			VkCommandBuffer cmdBuffer = commandBuffers[used++];
+
+			if (begin)
+			{
+				assert((level == VK_COMMAND_BUFFER_LEVEL_PRIMARY) || inheritance);
+				VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+				cmdBufInfo.flags = usageFlags;
+				cmdBufInfo.pInheritanceInfo = inheritance;
+				VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffer, &cmdBufInfo));
+			}
+
+			return cmdBuffer;
+		}
+
+		/**
+		* Reset the pools of all threads for a frame slot in bulk, called by beginFrame
+		*
+		* @param slot Frame slot to reset
+		*
+		* @note The command buffers of the slot must have finished executing and no thread may be recording into them
+		*/
+		void resetThreadCommandPools(uint32_t slot)
+		{
+			std::lock_guard<std::mutex> lock(threadCommandPoolsMutex);
+			for (auto &threadPools : threadCommandPools)
+			{
+				if (slot >= threadPools.second.size())
+				{
+					continue;
+				}
+				ThreadCommandPool &threadPool = threadPools.second[slot];
+				if (threadPool.used[0] + threadPool.used[1] > 0)
+				{
+					VK_CHECK_RESULT(vkResetCommandPool(logicalDevice, threadPool.pool, 0));
+					threadPool.used[0] = threadPool.used[1] = 0;
+				}
+			}
+		}
+
+		/**
+		* Get the shared staging ring, created on first use
+		*
+		* @return Staging ring submitting to the first queue of the graphics family
+		*
+		* @note The ring may be used from loader threads, its submits take the queue's lock like every other submit to the graphics queue
+		*
+		* @note Copies recorded into the ring are submitted in batches, call submit() on the ring (done by the example base before each frame) or finish() to wait for them
+		*/
+		vks::StagingRing *getStagingRing()
+		{
+			if (!stagingRing)
+			{
+				VkQueue queue;
+				vkGetDeviceQueue(logicalDevice, queueFamilyIndices.graphics, 0, &queue);
+				stagingRing = new vks::StagingRing(logicalDevice, memoryAllocator, queue, queueFamilyIndices.graphics, stagingRingSize, properties.limits.optimalBufferCopyOffsetAlignment, &queueMutex(queue));
+			}
+			return stagingRing;
+		}
+
+		/**
+		* Get the staging ring used for asynchronous uploads
+		*
+		* @return Ring submitting to the transfer queue, or the shared staging ring if there is no separate transfer family
+		*/
+		vks::StagingRing *getTransferRing()
+		{
+			if (queueFamilyIndices.transfer == queueFamilyIndices.graphics)
+			{
+				return getStagingRing();
+			}
+			if (!transferRing)
+			{
+				transferRing = new vks::StagingRing(logicalDevice, memoryAllocator, transferQueue, queueFamilyIndices.transfer, stagingRingSize, properties.limits.optimalBufferCopyOffsetAlignment, &queueMutex(transferQueue));
+			}
+			return transferRing;
+		}
+
+		/**
+		* Upload data to a device local buffer without blocking
+		*
+		* @param data Pointer to the data to upload
+		* @param size Size of the data in bytes
+		* @param dstBuffer Destination buffer (must have the TRANSFER_DST usage flag set and exclusive sharing mode)
+		* @param dstOffset (Optional) Offset into the destination buffer
+		*
+		* @return Token to acquire on the graphics queue before the first use of the buffer, the submission containing the acquire has to wait on takeUploadWaits
+		*
+		* @note The copy is submitted with the next batch of the transfer ring (before the next frame or when the token is waited on)
+		*/
+		vks::UploadToken uploadBufferAsync(const void *data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0)
+		{
+			vks::StagingRing *ring = getTransferRing();
+			std::lock_guard<std::recursive_mutex> lock(ring->mutex);
+			ring->copyToBuffer(data, size, dstBuffer, dstOffset);
+			vks::UploadToken token;
+			ring->release(token, dstBuffer, dstOffset, size, queueFamilyIndices.graphics);
+			return token;
+		}
 
-			// Create fence to ensure that the command buffer has finished executing
-			VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+		/**
+		* Upload data to an optimal tiled image without blocking
+		*
+		* @param data Pointer to the texel data of all copied subresources
+		* @param size Size of the data in bytes
+		* @param image Destination image (must have the TRANSFER_DST usage flag set and exclusive sharing mode)
+		* @param copyRegions Buffer to image copy regions, buffer offsets are relative to data
+		* @param texelBlockSize Size in bytes of a texel (or compressed block) of the image format, the staged data is aligned to it
+		* @param subresourceRange Subresources written by the copy regions
+		* @param imageLayout (Optional) Layout the image is used in after the upload (Defaults to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+		*
+		* @return Token to acquire on the graphics queue before the first use of the image, the submission containing the acquire has to wait on takeUploadWaits
+		*
+		* @note The image contents are discarded, it is transitioned from VK_IMAGE_LAYOUT_UNDEFINED
+		*/
+		vks::UploadToken uploadImageAsync(const void *data, VkDeviceSize size, VkImage image, std::vector<VkBufferImageCopy> copyRegions, VkDeviceSize texelBlockSize, VkImageSubresourceRange subresourceRange, VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+		{
+			vks::StagingRing *ring = getTransferRing();
+			std::lock_guard<std::recursive_mutex> lock(ring->mutex);
+			vks::StagingRegion region = ring->stage(data, size, ring->imageCopyAlignment(texelBlockSize));
+			VkCommandBuffer copyCmd = ring->commandBuffer();
+			for (auto &copyRegion : copyRegions)
+			{
+				copyRegion.bufferOffset += region.offset;
+			}
+
+			VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.image = image;
+			barrier.subresourceRange = subresourceRange;
+			vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			vkCmdCopyBufferToImage(copyCmd, region.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+
+			vks::UploadToken token;
+			ring->release(token, image, subresourceRange, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, imageLayout, queueFamilyIndices.graphics);
+			return token;
+		}
+
+		/**
+		* Add the semaphores of asynchronous uploads acquired since the last call to the waits of a graphics queue submission
+		*
+		* @param waitSemaphores Wait semaphores of the submission, the upload semaphores are appended
+		* @param waitStages Wait stages of the submission, resized to the number of semaphores
+		*
+		* @note The submission must contain or follow the command buffers the tokens were acquired in (see UploadToken::acquire), the semaphores are destroyed once the frame being recorded has finished
+		*/
+		void takeUploadWaits(std::vector<VkSemaphore> &waitSemaphores, std::vector<VkPipelineStageFlags> &waitStages)
+		{
+			if (!transferRing)
+			{
+				return;
+			}
+			size_t first = waitSemaphores.size();
+			transferRing->takeAcquiredSemaphores(waitSemaphores);
+			waitStages.resize(waitSemaphores.size(), VK_PIPELINE_STAGE_ALL_COMMANDS_BIT);
+			VkDevice device = logicalDevice;
+			for (size_t i = first; i < waitSemaphores.size(); i++)
+			{
+				VkSemaphore semaphore = waitSemaphores[i];
+				retire([device, semaphore]() { vkDestroySemaphore(device, semaphore, nullptr); });
+			}
+		}
+
+		/** @brief Submit the pending flushes grouped by consecutive queue, wait for them and recycle their fences and command buffers */
+		void submitPendingFlushes()
+		{
+			if (pendingFlushes.empty())
+			{
+				return;
+			}
+
+			// Copies still pending in the staging ring must be executed before commands that may read their results
+			if (stagingRing)
+			{
+				stagingRing->submit();
+			}
+
+			std::vector<VkFence> fences;
+			std::vector<VkCommandBuffer> commandBuffers;
+			size_t i = 0;
+			while (i < pendingFlushes.size())
+			{
+				VkQueue queue = pendingFlushes[i].queue;
+				commandBuffers.clear();
+				for (; (i < pendingFlushes.size()) && (pendingFlushes[i].queue == queue); i++)
+				{
+					commandBuffers.push_back(pendingFlushes[i].commandBuffer);
+				}
+
+				VkFence fence = acquireFence();
+				fences.push_back(fence);
+
+				VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+				submitInfo.commandBufferCount = static_cast<uint32_t>(commandBuffers.size());
+				submitInfo.pCommandBuffers = commandBuffers.data();
+				// The flushed command buffers may acquire uploads of the transfer ring
+				std::vector<VkSemaphore> waitSemaphores;
+				std::vector<VkPipelineStageFlags> waitStages;
+				if (queue != transferQueue)
+				{
+					takeUploadWaits(waitSemaphores, waitStages);
+				}
+				submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+				submitInfo.pWaitSemaphores = waitSemaphores.data();
+				submitInfo.pWaitDstStageMask = waitStages.data();
+				VK_CHECK_RESULT(queueSubmit(queue, 1, &submitInfo, fence));
+			}
+
+			// Wait for the fences to signal that the command buffers have finished executing
+			VK_CHECK_RESULT(vkWaitForFences(logicalDevice, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			VK_CHECK_RESULT(vkResetFences(logicalDevice, static_cast<uint32_t>(fences.size()), fences.data()));
+			freeFences.insert(freeFences.end(), fences.begin(), fences.end());
+
+			for (auto &flush : pendingFlushes)
+			{
+				if (flush.free)
+				{
+					VK_CHECK_RESULT(vkResetCommandBuffer(flush.commandBuffer, 0));
+					freeCommandBuffers.push_back(flush.commandBuffer);
+				}
+			}
+			pendingFlushes.clear();
+		}
+
+		/**
+		* Get the lock of a queue, created on first use
+		*
+		* @param queue Queue to get the lock for
+		*
+		* @return Mutex to hold while submitting to or presenting on the queue
+		*
+		* @note Only held for the duration of the call accessing the queue, no other lock may be taken while holding it
+		*/
+		std::mutex &queueMutex(VkQueue queue)
+		{
+			std::lock_guard<std::mutex> lock(queueMutexesMutex);
+			std::unique_ptr<std::mutex> &mutex = queueMutexes[queue];
+			if (!mutex)
+			{
+				mutex.reset(new std::mutex());
+			}
+			return *mutex;
+		}
+
+		/**
+		* Submit to a queue while holding its lock, safe to call from several threads at once
+		*
+		* @note Parameters are the same as for vkQueueSubmit, all submits to queues shared with loader threads have to go through this
+		*/
+		VkResult queueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo *submits, VkFence fence)
+		{
+			std::lock_guard<std::mutex> lock(queueMutex(queue));
+			return vkQueueSubmit(queue, submitCount, submits, fence);
+		}
+
+		/** @brief Get an unsignaled fence from the pool, a new one is created if the pool is empty */
+		VkFence acquireFence()
+		{
 			VkFence fence;
-			VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence));
-			
-			// Submit to the queue
-			VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
-			// Wait for the fence to signal that command buffer has finished executing
-			VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+			if (!freeFences.empty())
+			{
+				fence = freeFences.back();
+				freeFences.pop_back();
+			}
+			else
+			{
+				VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+				VK_CHECK_RESULT(vkCreateFence(logicalDevice, &fenceInfo, nullptr, &fence));
+			}
+			return fence;
+		}
+
+		/**
+		* Register a function called at the start of each frame with the frame slot being prepared
+		*
+		* @param callback Function writing the per frame slot resources of its owner, the frame that last used the slot has completed when it is called
+		*
+		* @return Id of the callback, to be passed to removeFrameCallback
+		*/
+		uint64_t addFrameCallback(std::function<void(uint32_t)> callback)
+		{
+			uint64_t id = nextFrameCallbackId++;
+			frameCallbacks[id] = std::move(callback);
+			return id;
+		}
+
+		/** @brief Remove a function registered with addFrameCallback */
+		void removeFrameCallback(uint64_t id)
+		{
+			frameCallbacks.erase(id);
+		}
+
+		/**
+		* Start preparing a frame in a slot, resets the slot's thread command pools and calls the registered frame callbacks
+		*
+		* @param slot Frame slot in [0, framesInFlight), the frame that used it before must have completed (see waitForFrame)
+		*/
+		void beginFrame(uint32_t slot)
+		{
+			frameIndex = slot;
+			resetThreadCommandPools(slot);
+			for (auto &callback : frameCallbacks)
+			{
+				callback.second(slot);
+			}
+		}
+
+		/**
+		* Mark the end of the current frame on a queue and advance frameSerial
+		*
+		* @param queue Queue the frame's command buffers have been submitted to
+		*
+		* @return Serial of the frame that has been ended
+		*
+		* @note Submits an empty batch with a fence, the fence signals once all work submitted to the queue before it has completed
+		*/
+		uint64_t endFrame(VkQueue queue)
+		{
+			VkFence fence = acquireFence();
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			VK_CHECK_RESULT(queueSubmit(queue, 1, &submitInfo, fence));
+			frameFences.push_back({ frameSerial, fence });
+			return frameSerial++;
+		}
+
+		/**
+		* Wait until a frame has finished executing on the device
+		*
+		* @param serial Serial of the frame returned by endFrame, frames that are already complete (or serial 0) return immediately
+		*/
+		void waitForFrame(uint64_t serial)
+		{
+			while ((serial > completedFrameSerial) && !frameFences.empty())
+			{
+				VK_CHECK_RESULT(vkWaitForFences(logicalDevice, 1, &frameFences.front().second, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+				updateCompletedFrames();
+			}
+		}
+
+		/** @brief Advance completedFrameSerial to the last finished frame and destroy the retired buffers no frame can use anymore (non blocking) */
+		void updateCompletedFrames()
+		{
+			while (!frameFences.empty() && (vkGetFenceStatus(logicalDevice, frameFences.front().second) == VK_SUCCESS))
+			{
+				VkFence fence = frameFences.front().second;
+				completedFrameSerial = frameFences.front().first;
+				VK_CHECK_RESULT(vkResetFences(logicalDevice, 1, &fence));
+				freeFences.push_back(fence);
+				frameFences.pop_front();
+			}
+			while (!retiredBuffers.empty() && (retiredBuffers.front().first <= completedFrameSerial))
+			{
+				retiredBuffers.front().second.destroy();
+				retiredBuffers.pop_front();
+			}
+			while (!retiredObjects.empty() && (retiredObjects.front().first <= completedFrameSerial))
+			{
+				retiredObjects.front().second();
+				retiredObjects.pop_front();
+			}
+		}
+
+		/**
+		* Hand a buffer over to be destroyed once the frame being recorded has finished executing
+		*
+		* @param buffer Buffer to retire, reset to an empty buffer by the call
+		*/
+		void retireBuffer(vks::Buffer &buffer)
+		{
+			retiredBuffers.push_back({ frameSerial, buffer });
+			buffer = vks::Buffer();
+		}
+
+		/**
+		* Defer the destruction of objects the frames in flight may still use
+		*
+		* @param release Function destroying the objects, called once the frame being recorded has finished executing
+		*/
+		void retire(std::function<void()> release)
+		{
+			retiredObjects.push_back({ frameSerial, std::move(release) });
+		}
+
+		/** @brief Destroy an image once the frame being recorded has finished executing */
+		void retireImage(VkImage image)
+		{
+			if (image == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			VkDevice device = logicalDevice;
+			retire([device, image]() { vkDestroyImage(device, image, nullptr); });
+		}
+
+		/** @brief Destroy an image view once the frame being recorded has finished executing */
+		void retireImageView(VkImageView view)
+		{
+			if (view == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			VkDevice device = logicalDevice;
+			retire([device, view]() { vkDestroyImageView(device, view, nullptr); });
+		}
 
-			vkDestroyFence(logicalDevice, fence, nullptr);
+		/** @brief Destroy a sampler once the frame being recorded has finished executing */
+		void retireSampler(VkSampler sampler)
+		{
+			if (sampler == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			VkDevice device = logicalDevice;
+			retire([device, sampler]() { vkDestroySampler(device, sampler, nullptr); });
+		}
 
-			if (free)
+		/** @brief Destroy a pipeline once the frame being recorded has finished executing */
+		void retirePipeline(VkPipeline pipeline)
+		{
+			if (pipeline == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			VkDevice device = logicalDevice;
+			retire([device, pipeline]() { vkDestroyPipeline(device, pipeline, nullptr); });
+		}
+
+		/** @brief Free device memory allocated outside of the memory allocator once the frame being recorded has finished executing */
+		void retireMemory(VkDeviceMemory memory)
+		{
+			if (memory == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			VkDevice device = logicalDevice;
+			retire([device, memory]() { vkFreeMemory(device, memory, nullptr); });
+		}
+
+		/**
+		* Give a sub-allocation back to the memory allocator once the frame being recorded has finished executing
+		*
+		* @param allocation Allocation to release, reset to an empty allocation
+		*/
+		void retireAllocation(vks::Allocation &allocation)
+		{
+			if (!allocation.block)
+			{
+				return;
+			}
+			vks::Allocation retired = allocation;
+			allocation = vks::Allocation();
+			retire([this, retired]() mutable { freeMemory(retired); });
+		}
+
+		/**
+		* Release all retired buffers and objects regardless of their frame serial
+		*
+		* @note The device must be idle (e.g. before tearing down objects the retired ones depend on)
+		*/
+		void releaseRetired()
+		{
+			for (auto &retired : retiredBuffers)
+			{
+				retired.second.destroy();
+			}
+			retiredBuffers.clear();
+			for (auto &retired : retiredObjects)
 			{
-				vkFreeCommandBuffers(logicalDevice, commandPool, 1, &commandBuffer);
+				retired.second();
 			}
+			retiredObjects.clear();
 		}
 
 		/**
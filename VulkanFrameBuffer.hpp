@@ -24,6 +24,8 @@ namespace vks
 	{
 		VkImage image;
 		VkDeviceMemory memory;
+		/** @brief Sub-range of a device memory block backing the image (memory is the block's handle) */
+		vks::Allocation allocation;
 		VkImageView view;
 		VkFormat format;
 		VkImageSubresourceRange subresourceRange;
@@ -113,11 +115,11 @@ namespace vks
 		~Framebuffer()
 		{
 			assert(vulkanDevice);
-			for (auto attachment : attachments)
+			for (auto &attachment : attachments)
 			{
 				vkDestroyImage(vulkanDevice->logicalDevice, attachment.image, nullptr);
 				vkDestroyImageView(vulkanDevice->logicalDevice, attachment.view, nullptr);
-				vkFreeMemory(vulkanDevice->logicalDevice, attachment.memory, nullptr);
+				vulkanDevice->freeMemory(attachment.allocation);
 			}
 			vkDestroySampler(vulkanDevice->logicalDevice, sampler, nullptr);
 			vkDestroyRenderPass(vulkanDevice->logicalDevice, renderPass, nullptr);
@@ -174,16 +176,10 @@ namespace vks
 			image.tiling = VK_IMAGE_TILING_OPTIMAL;
 			image.usage = createinfo.usage;
 
-			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
-			VkMemoryRequirements memReqs;
-
 			// Create image for this attachment
 			VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &image, nullptr, &attachment.image));
-			vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, attachment.image, &memReqs);
-			memAlloc.allocationSize = memReqs.size;
-			memAlloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-			VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &memAlloc, nullptr, &attachment.memory));
-			VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, attachment.image, attachment.memory, 0));
+			VK_CHECK_RESULT(vulkanDevice->allocateImageMemory(attachment.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &attachment.allocation, VK_IMAGE_TILING_OPTIMAL, vks::MemoryCategory::Attachment));
+			attachment.memory = attachment.allocation.memory;
 
 			attachment.subresourceRange = {};
 			attachment.subresourceRange.aspectMask = aspectMask;
@@ -0,0 +1,174 @@
+/*
+* Vulkan growable buffer
+*
+* Buffer with a capacity that grows geometrically as data is appended, the replaced buffer is
+* retired with the current frame instead of waiting for the device to become idle
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <mutex>
+#include <string.h>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanBuffer.hpp"
+#include "VulkanDevice.hpp"
+
+namespace vks
+{
+	/**
+	* @brief Buffer that grows when data is appended past its capacity
+	* @note Growing replaces the buffer handle, descriptors and command buffers referencing it must be updated when version changes
+	* (command buffers of the example base can track it with VulkanExampleBase::addCommandBufferDependency)
+	*/
+	struct GrowableBuffer : public Buffer
+	{
+		vks::VulkanDevice *vulkanDevice = nullptr;
+		/** @brief Bytes from the start of the buffer holding valid data, appended data is written after them */
+		VkDeviceSize used = 0;
+		/** @brief Factor the capacity is multiplied with when appended data does not fit */
+		float growthFactor = 2.0f;
+		/** @brief Incremented each time the buffer handle is replaced */
+		uint32_t version = 0;
+
+		/**
+		* Create the buffer
+		*
+		* @param device Device the buffer is created on
+		* @param usageFlags Usage flag bitmask for the buffer, transfer source and destination usages are added for growing
+		* @param memoryPropertyFlags Memory properties for this buffer, host visible buffers are kept mapped
+		* @param capacity Initial capacity in bytes
+		*
+		* @return VK_SUCCESS if the buffer has been created
+		*/
+		VkResult create(vks::VulkanDevice *device, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize capacity)
+		{
+			vulkanDevice = device;
+			used = 0;
+			return allocate(usageFlags | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, memoryPropertyFlags, capacity);
+		}
+
+		/**
+		* Make sure the buffer can hold at least requiredSize bytes
+		*
+		* @param requiredSize Number of bytes the buffer must be able to hold
+		*
+		* @return True if the buffer has been replaced by a larger one
+		*
+		* @note The used range of mapped buffers is copied on the host, other buffers copy it on the device with the staging ring.
+		* Either way the copy is ordered before later update() calls. The old buffer is retired with the current frame
+		*/
+		bool reserve(VkDeviceSize requiredSize)
+		{
+			if (requiredSize <= size)
+			{
+				return false;
+			}
+
+			VkDeviceSize capacity = std::max(requiredSize, (VkDeviceSize)((double)size * growthFactor));
+			vks::Buffer old = *this;
+			VK_CHECK_RESULT(allocate(usageFlags, memoryPropertyFlags, capacity));
+
+			if ((used > 0) && old.mapped && mapped)
+			{
+				// update() writes mapped buffers directly, a pending device copy of the used range would overwrite those writes later
+				memcpy(static_cast<uint8_t*>(mapped) - mappedOffset, static_cast<uint8_t*>(old.mapped) - old.mappedOffset, used);
+				markDirty(0, used);
+				VK_CHECK_RESULT(commit());
+			}
+			else if (used > 0)
+			{
+				// update() goes through the same ring for buffers that are not mapped, its copies into the old buffer
+				// may be recorded in the same command buffer and have to finish before the used range is read
+				vks::StagingRing *staging = vulkanDevice->getStagingRing();
+				std::lock_guard<std::recursive_mutex> lock(staging->mutex);
+				VkCommandBuffer copyCmd = staging->commandBuffer();
+				VkBufferMemoryBarrier barrier = vks::initializers::bufferMemoryBarrier();
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+				barrier.buffer = old.buffer;
+				barrier.offset = 0;
+				barrier.size = used;
+				vkCmdPipelineBarrier(copyCmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+				VkBufferCopy copyRegion = { 0, 0, used };
+				vkCmdCopyBuffer(copyCmd, old.buffer, buffer, 1, &copyRegion);
+				// Submitted right away so the copy executes before any frame that uses the new buffer, the barrier ending
+				// the batch also orders it before later update() copies into the new buffer
+				staging->submit();
+			}
+
+			vulkanDevice->retireBuffer(old);
+			version++;
+			return true;
+		}
+
+		/**
+		* Append data after the used range, growing the buffer if needed
+		*
+		* @param data Pointer to the data to append
+		* @param dataSize Size of the data in bytes
+		*
+		* @return True if the buffer has been replaced by a larger one
+		*/
+		bool append(const void *data, VkDeviceSize dataSize)
+		{
+			bool grown = reserve(used + dataSize);
+			update(used, data, dataSize);
+			used += dataSize;
+			return grown;
+		}
+
+		/**
+		* Overwrite a range of the buffer
+		*
+		* @param offset Byte offset of the range
+		* @param data Pointer to the data to write
+		* @param dataSize Size of the data in bytes
+		*
+		* @note Mapped buffers are written directly and only the written range is flushed, other buffers are written through the staging ring
+		*/
+		void update(VkDeviceSize offset, const void *data, VkDeviceSize dataSize)
+		{
+			assert(offset + dataSize <= size);
+			if (dataSize == 0)
+			{
+				return;
+			}
+			if (mapped)
+			{
+				assert(offset >= mappedOffset);
+				memcpy(static_cast<uint8_t*>(mapped) + (offset - mappedOffset), data, dataSize);
+				markDirty(offset, dataSize);
+				VK_CHECK_RESULT(commit());
+			}
+			else
+			{
+				vulkanDevice->getStagingRing()->copyToBuffer(data, dataSize, buffer, offset);
+			}
+		}
+
+		/** @brief Release the buffer immediately, the device must not use it anymore */
+		void destroy()
+		{
+			Buffer::destroy();
+			size = 0;
+			used = 0;
+		}
+
+	private:
+		VkResult allocate(VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryPropertyFlags, VkDeviceSize capacity)
+		{
+			VK_CHECK_RESULT(vulkanDevice->createBuffer(usageFlags, memoryPropertyFlags, static_cast<vks::Buffer*>(this), capacity));
+			if (memoryPropertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+			{
+				return map();
+			}
+			return VK_SUCCESS;
+		}
+	};
+}
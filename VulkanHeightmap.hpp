@@ -13,6 +13,7 @@
 #include "vulkan/vulkan.h"
 #include "VulkanDevice.hpp"
 #include "VulkanBuffer.hpp"
+#include "trace.hpp"
 
 namespace vks 
 {
@@ -72,6 +73,7 @@ namespace vks
 		void loadFromFile(const std::string filename, uint32_t patchsize, glm::vec3 scale, Topology topology)
 #endif
 		{
+			VKS_TRACE_ZONE("Heightmap load");
 			assert(device);
 			assert(copyQueue != VK_NULL_HANDLE);
 
@@ -192,63 +194,13 @@ namespace vks
 
 			// Generate Vulkan buffers
 
-			vks::Buffer vertexStaging, indexStaging;
-
-			// Create staging buffers
-			device->createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				&vertexStaging,
-				vertexBufferSize,
-				vertices);
-
-			device->createBuffer(
-				VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-				&indexStaging,
-				indexBufferSize,
-				indices);
-
-			// Device local (target) buffer
-			device->createBuffer(
-				VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				&vertexBuffer,
-				vertexBufferSize);
-
-			device->createBuffer(
-				VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-				&indexBuffer,
-				indexBufferSize);
-
-			// Copy from staging buffers
-			VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-			VkBufferCopy copyRegion = {};
-
-			copyRegion.size = vertexBufferSize;
-			vkCmdCopyBuffer(
-				copyCmd,
-				vertexStaging.buffer,
-				vertexBuffer.buffer,
-				1,
-				&copyRegion);
-
-			copyRegion.size = indexBufferSize;
-			vkCmdCopyBuffer(
-				copyCmd,
-				indexStaging.buffer,
-				indexBuffer.buffer,
-				1,
-				&copyRegion);
-
-			device->flushCommandBuffer(copyCmd, copyQueue, true);
-
-			vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-			vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-			vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+			// Device local buffers, written directly on devices with host visible device local memory, staged otherwise
+			device->createDeviceLocalBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertexBuffer, vertexBufferSize, vertices);
+			device->createDeviceLocalBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &indexBuffer, indexBufferSize, indices);
+
+			// Both paths have copied the data
+			delete[] vertices;
+			delete[] indices;
 		}
 	};
 }
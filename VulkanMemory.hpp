@@ -0,0 +1,584 @@
+/*
+* Vulkan device memory allocator
+*
+* Sub-allocates buffers and images from large per memory type blocks
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <list>
+#include <iterator>
+#include <mutex>
+#include <algorithm>
+#include <functional>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+
+namespace vks
+{
+	struct MemoryAllocator;
+	struct MemoryBlock;
+
+	/** @brief Kind of resource bound to a sub-allocation, buffers and linear images must not share a bufferImageGranularity page with optimal images */
+	enum class AllocationType : uint32_t
+	{
+		Free = 0,
+		Linear = 1,
+		Optimal = 2
+	};
+
+	/** @brief Kind of resource an allocation is made for, used to account memory usage */
+	enum class MemoryCategory : uint32_t
+	{
+		Other = 0,
+		/** @brief Vertex, index, uniform and storage buffers */
+		Buffer = 1,
+		/** @brief Sampled images */
+		Texture = 2,
+		/** @brief Framebuffer attachments (color, depth) */
+		Attachment = 3,
+		/** @brief Host visible upload memory */
+		Staging = 4,
+		Count = 5
+	};
+
+	/**
+	* @brief Range of device memory handed out by the MemoryAllocator
+	* @note Must be given back with MemoryAllocator::free instead of vkFreeMemory, as the memory handle is shared with other allocations
+	*/
+	struct Allocation
+	{
+		/** @brief Block this allocation has been taken from, nullptr if not allocated */
+		MemoryBlock *block = nullptr;
+		/** @brief Memory handle of the block, resources must be bound at offset */
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIndex = 0;
+		/** @brief Host address of this allocation if the memory type is host visible (blocks are persistently mapped) */
+		void *mapped = nullptr;
+		MemoryCategory category = MemoryCategory::Other;
+	};
+
+	/**
+	* @brief Single VkDeviceMemory allocation that is split into sub-ranges
+	* @note Ranges are kept sorted by offset, neighbouring free ranges are always merged
+	*/
+	struct MemoryBlock
+	{
+		struct Range
+		{
+			VkDeviceSize offset;
+			VkDeviceSize size;
+			AllocationType type;
+		};
+
+		MemoryAllocator *allocator = nullptr;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize size = 0;
+		uint32_t memoryTypeIndex = 0;
+		void *mapped = nullptr;
+		/** @brief Block has been created for a single large allocation and is released with it */
+		bool dedicated = false;
+		VkDeviceSize used = 0;
+		uint32_t allocationCount = 0;
+		std::list<Range> ranges;
+
+		static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+		{
+			return (alignment > 1) ? (value + alignment - 1) / alignment * alignment : value;
+		}
+
+		/** @brief Returns true if the end of a resource and the start of the following one fall into the same granularity page */
+		static bool onSamePage(VkDeviceSize endA, VkDeviceSize startB, VkDeviceSize pageSize)
+		{
+			VkDeviceSize endPage = endA & ~(pageSize - 1);
+			VkDeviceSize startPage = startB & ~(pageSize - 1);
+			return endPage >= startPage;
+		}
+
+		/**
+		* Find a free range that can hold the requested allocation (first fit)
+		*
+		* @param size Size of the requested range
+		* @param alignment Required alignment of the offset
+		* @param type Resource type, used to keep linear and optimal resources on separate granularity pages
+		* @param granularity bufferImageGranularity of the physical device
+		* @param offset Pointer to the offset of the new range
+		*
+		* @return True if the allocation fits into this block
+		*/
+		bool allocate(VkDeviceSize size, VkDeviceSize alignment, AllocationType type, VkDeviceSize granularity, VkDeviceSize *offset)
+		{
+			for (auto it = ranges.begin(); it != ranges.end(); ++it)
+			{
+				if ((it->type != AllocationType::Free) || (it->size < size))
+				{
+					continue;
+				}
+
+				VkDeviceSize start = alignUp(it->offset, alignment);
+
+				// Free ranges are merged, so the previous range (if any) is in use
+				if ((granularity > 1) && (it != ranges.begin()))
+				{
+					auto prev = std::prev(it);
+					if ((prev->type != type) && onSamePage(prev->offset + prev->size - 1, start, granularity))
+					{
+						start = alignUp(start, granularity);
+					}
+				}
+
+				if (start + size > it->offset + it->size)
+				{
+					continue;
+				}
+
+				auto next = std::next(it);
+				if ((granularity > 1) && (next != ranges.end()) && (next->type != type) && onSamePage(start + size - 1, next->offset, granularity))
+				{
+					continue;
+				}
+
+				// Split off the alignment padding and the remaining tail as new free ranges
+				VkDeviceSize padding = start - it->offset;
+				VkDeviceSize tail = (it->offset + it->size) - (start + size);
+				if (padding > 0)
+				{
+					ranges.insert(it, { it->offset, padding, AllocationType::Free });
+				}
+				if (tail > 0)
+				{
+					ranges.insert(next, { start + size, tail, AllocationType::Free });
+				}
+				it->offset = start;
+				it->size = size;
+				it->type = type;
+
+				used += size;
+				allocationCount++;
+				*offset = start;
+				return true;
+			}
+			return false;
+		}
+
+		/** @brief Return the range starting at offset to the block and merge it with free neighbours */
+		void free(VkDeviceSize offset)
+		{
+			auto it = std::find_if(ranges.begin(), ranges.end(), [offset](const Range &range) { return (range.offset == offset) && (range.type != AllocationType::Free); });
+			assert(it != ranges.end());
+
+			used -= it->size;
+			allocationCount--;
+			it->type = AllocationType::Free;
+
+			auto next = std::next(it);
+			if ((next != ranges.end()) && (next->type == AllocationType::Free))
+			{
+				it->size += next->size;
+				ranges.erase(next);
+			}
+			if (it != ranges.begin())
+			{
+				auto prev = std::prev(it);
+				if (prev->type == AllocationType::Free)
+				{
+					prev->size += it->size;
+					ranges.erase(it);
+				}
+			}
+		}
+
+		/** @brief Size of the largest free range of this block */
+		VkDeviceSize largestFreeRange() const
+		{
+			VkDeviceSize largest = 0;
+			for (auto &range : ranges)
+			{
+				if (range.type == AllocationType::Free)
+				{
+					largest = std::max(largest, range.size);
+				}
+			}
+			return largest;
+		}
+	};
+
+	/**
+	* @brief Keeps per memory type pools of large device memory blocks and hands out aligned sub-ranges
+	* @note Keeps the number of vkAllocateMemory calls (limited by maxMemoryAllocationCount) low, thread safe
+	*/
+	struct MemoryAllocator
+	{
+		/** @brief Usage statistics of a single memory heap */
+		struct HeapStats
+		{
+			/** @brief Bytes allocated from the driver as memory blocks */
+			VkDeviceSize blockBytes = 0;
+			/** @brief Bytes handed out to resources */
+			VkDeviceSize usedBytes = 0;
+			uint32_t blockCount = 0;
+			uint32_t allocationCount = 0;
+			/** @brief Bytes of the heap the application may use (see setHeapBudget) */
+			VkDeviceSize budget = 0;
+			/** @brief Bytes of the heap used by other processes and memory not allocated through this allocator */
+			VkDeviceSize externalUsage = 0;
+			/** @brief Bytes of the heap handed out per resource category, indexed by MemoryCategory */
+			VkDeviceSize categoryBytes[(uint32_t)MemoryCategory::Count] = {};
+		};
+
+		/** @brief Allocator wide statistics */
+		struct Stats
+		{
+			/** @brief Number of live VkDeviceMemory blocks */
+			uint32_t blockCount = 0;
+			uint32_t allocationCount = 0;
+			VkDeviceSize blockBytes = 0;
+			VkDeviceSize usedBytes = 0;
+			/** @brief 0 if all free memory is contiguous, approaching 1 if free memory is scattered in small ranges (1 - largest free range / total free) */
+			float fragmentation = 0.0f;
+			/** @brief Stats per memory heap, indexed like VkPhysicalDeviceMemoryProperties::memoryHeaps */
+			std::vector<HeapStats> heaps;
+			/** @brief Bytes handed out per resource category summed over all heaps, indexed by MemoryCategory (see HeapStats for the split per heap) */
+			VkDeviceSize categoryBytes[(uint32_t)MemoryCategory::Count] = {};
+		};
+
+		/** @brief Budget state of a memory heap */
+		struct HeapBudget
+		{
+			/** @brief Bytes of memory blocks allocated from the heap */
+			VkDeviceSize blockBytes = 0;
+			VkDeviceSize budget = 0;
+			VkDeviceSize externalUsage = 0;
+			/** @brief Bytes of the heap handed out per resource category */
+			VkDeviceSize categoryBytes[(uint32_t)MemoryCategory::Count] = {};
+			/** @brief Usage is above the threshold, the callback fires again only after usage went back below it */
+			bool exceeded = false;
+		};
+
+		VkDevice device;
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		VkDeviceSize bufferImageGranularity;
+		VkDeviceSize nonCoherentAtomSize;
+		/** @brief Preferred size of new memory blocks, allocations larger than half of it get a dedicated block */
+		VkDeviceSize blockSize = 64 * 1024 * 1024;
+
+		/** @brief Memory blocks per memory type index */
+		std::vector<std::vector<MemoryBlock*>> pools;
+		std::mutex mutex;
+
+		/** @brief Budget state per memory heap */
+		std::vector<HeapBudget> heapBudgets;
+		/** @brief Fraction of a heap budget above which budgetCallback is called */
+		float budgetThreshold = 0.9f;
+		/**
+		* @brief Called when the usage of a heap (own blocks and external usage) crosses budgetThreshold of its budget
+		* @note Called with the allocator locked, the callback must not allocate or free but can schedule evictions
+		* @note Not called while the allocator is destroyed
+		*/
+		std::function<void(uint32_t heapIndex, VkDeviceSize usage, VkDeviceSize budget)> budgetCallback;
+
+		/**
+		* Default constructor
+		*
+		* @param device Logical device the memory is allocated from
+		* @param memoryProperties Memory types and heaps of the physical device
+		* @param limits Limits of the physical device (for bufferImageGranularity and nonCoherentAtomSize)
+		*/
+		MemoryAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties &memoryProperties, const VkPhysicalDeviceLimits &limits)
+		{
+			this->device = device;
+			this->memoryProperties = memoryProperties;
+			bufferImageGranularity = std::max<VkDeviceSize>(limits.bufferImageGranularity, 1);
+			nonCoherentAtomSize = std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1);
+			pools.resize(memoryProperties.memoryTypeCount);
+			// Without VK_EXT_memory_budget the whole heap is assumed to be available
+			heapBudgets.resize(memoryProperties.memoryHeapCount);
+			for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+			{
+				heapBudgets[i].budget = memoryProperties.memoryHeaps[i].size;
+			}
+		}
+
+		/**
+		* Default destructor
+		*
+		* @note Frees all memory blocks, resources still bound to them must have been destroyed before
+		*/
+		~MemoryAllocator()
+		{
+			// Releasing the blocks changes the heap usage, the owner of the callback may already be gone
+			budgetCallback = nullptr;
+			for (auto &pool : pools)
+			{
+				for (auto block : pool)
+				{
+					destroyBlock(block);
+				}
+				pool.clear();
+			}
+		}
+
+		/**
+		* Allocate a range of device memory
+		*
+		* @param memReqs Memory requirements of the resource (size, alignment)
+		* @param memoryTypeIndex Index of the memory type to allocate from (see VulkanDevice::getMemoryType)
+		* @param type Kind of resource the memory is bound to (buffers and linear images vs. optimal images)
+		* @param allocation Pointer to the allocation to fill
+		* @param category (Optional) Kind of resource the memory is used for, for accounting only
+		*
+		* @return VK_SUCCESS if the allocation could be made, result of vkAllocateMemory if a new block failed to allocate
+		*/
+		VkResult allocate(const VkMemoryRequirements &memReqs, uint32_t memoryTypeIndex, AllocationType type, Allocation *allocation, MemoryCategory category = MemoryCategory::Other)
+		{
+			assert(memoryTypeIndex < memoryProperties.memoryTypeCount);
+			assert(type != AllocationType::Free);
+
+			VkDeviceSize alignment = std::max<VkDeviceSize>(memReqs.alignment, 1);
+			VkDeviceSize size = memReqs.size;
+
+			// Keep sub-ranges of non-coherent memory atom aligned, so flushing one of them never touches a neighbour
+			VkMemoryPropertyFlags propertyFlags = memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+			if ((propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+			{
+				alignment = std::max(alignment, nonCoherentAtomSize);
+				size = MemoryBlock::alignUp(size, nonCoherentAtomSize);
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			VkDeviceSize preferredSize = preferredBlockSize(memoryTypeIndex);
+			bool dedicated = (size > preferredSize / 2);
+
+			MemoryBlock *block = nullptr;
+			VkDeviceSize offset = 0;
+			if (!dedicated)
+			{
+				for (auto poolBlock : pools[memoryTypeIndex])
+				{
+					if (!poolBlock->dedicated && poolBlock->allocate(size, alignment, type, bufferImageGranularity, &offset))
+					{
+						block = poolBlock;
+						break;
+					}
+				}
+			}
+
+			if (block == nullptr)
+			{
+				VkResult result = createBlock(memoryTypeIndex, dedicated ? size : preferredSize, dedicated, &block);
+				if (result != VK_SUCCESS)
+				{
+					return result;
+				}
+				bool fits = block->allocate(size, alignment, type, bufferImageGranularity, &offset);
+				assert(fits);
+			}
+
+			allocation->block = block;
+			allocation->memory = block->memory;
+			allocation->offset = offset;
+			allocation->size = size;
+			allocation->memoryTypeIndex = memoryTypeIndex;
+			allocation->mapped = block->mapped ? static_cast<uint8_t*>(block->mapped) + offset : nullptr;
+			allocation->category = category;
+			heapBudgets[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].categoryBytes[(uint32_t)category] += size;
+
+			return VK_SUCCESS;
+		}
+
+		/**
+		* Give an allocation back to its block
+		*
+		* @note Empty dedicated blocks are released right away, only one empty shared block is kept per memory type
+		*/
+		void free(Allocation &allocation)
+		{
+			if (allocation.block == nullptr)
+			{
+				return;
+			}
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			MemoryBlock *block = allocation.block;
+			assert(block->allocator == this);
+			block->free(allocation.offset);
+			heapBudgets[memoryProperties.memoryTypes[block->memoryTypeIndex].heapIndex].categoryBytes[(uint32_t)allocation.category] -= allocation.size;
+
+			if (block->allocationCount == 0)
+			{
+				auto &pool = pools[block->memoryTypeIndex];
+				bool release = block->dedicated;
+				if (!release)
+				{
+					release = std::any_of(pool.begin(), pool.end(), [block](MemoryBlock *other) { return (other != block) && !other->dedicated && (other->allocationCount == 0); });
+				}
+				if (release)
+				{
+					pool.erase(std::remove(pool.begin(), pool.end(), block), pool.end());
+					destroyBlock(block);
+				}
+			}
+
+			allocation = Allocation();
+		}
+
+		/** @brief Gather statistics for all live memory blocks */
+		Stats getStats()
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			Stats stats;
+			stats.heaps.resize(memoryProperties.memoryHeapCount);
+			for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++)
+			{
+				stats.heaps[i].budget = heapBudgets[i].budget;
+				stats.heaps[i].externalUsage = heapBudgets[i].externalUsage;
+				for (uint32_t c = 0; c < (uint32_t)MemoryCategory::Count; c++)
+				{
+					stats.heaps[i].categoryBytes[c] = heapBudgets[i].categoryBytes[c];
+					stats.categoryBytes[c] += heapBudgets[i].categoryBytes[c];
+				}
+			}
+			VkDeviceSize freeBytes = 0;
+			VkDeviceSize largestFree = 0;
+			for (auto &pool : pools)
+			{
+				for (auto block : pool)
+				{
+					HeapStats &heap = stats.heaps[memoryProperties.memoryTypes[block->memoryTypeIndex].heapIndex];
+					heap.blockCount++;
+					heap.allocationCount += block->allocationCount;
+					heap.blockBytes += block->size;
+					heap.usedBytes += block->used;
+					stats.blockCount++;
+					stats.allocationCount += block->allocationCount;
+					stats.blockBytes += block->size;
+					stats.usedBytes += block->used;
+					if (!block->dedicated)
+					{
+						freeBytes += block->size - block->used;
+						largestFree = std::max(largestFree, block->largestFreeRange());
+					}
+				}
+			}
+			if (freeBytes > 0)
+			{
+				stats.fragmentation = 1.0f - (float)largestFree / (float)freeBytes;
+			}
+			return stats;
+		}
+
+		/**
+		* Set the budget of a memory heap
+		*
+		* @param heapIndex Index of the heap
+		* @param budget Bytes of the heap the application may use (e.g. VkPhysicalDeviceMemoryBudgetPropertiesEXT::heapBudget)
+		* @param externalUsage (Optional) Bytes of the heap used outside of this allocator
+		*/
+		void setHeapBudget(uint32_t heapIndex, VkDeviceSize budget, VkDeviceSize externalUsage = 0)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			assert(heapIndex < heapBudgets.size());
+			heapBudgets[heapIndex].budget = budget;
+			heapBudgets[heapIndex].externalUsage = externalUsage;
+			checkBudget(heapIndex);
+		}
+
+		/** @brief Bytes of memory blocks currently allocated from a heap */
+		VkDeviceSize getHeapUsage(uint32_t heapIndex)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			return heapBudgets[heapIndex].blockBytes;
+		}
+
+		/**
+		* Check if a new allocation would keep a heap below budgetThreshold of its budget
+		*
+		* @note Usage is counted in whole blocks, an allocation that fits into an existing block is checked conservatively
+		*/
+		bool fitsBudget(uint32_t heapIndex, VkDeviceSize size)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			const HeapBudget &heap = heapBudgets[heapIndex];
+			return heap.blockBytes + heap.externalUsage + size <= (VkDeviceSize)((double)heap.budget * budgetThreshold);
+		}
+
+	private:
+		/** @brief Call the budget callback if the usage of a heap went above the threshold since the last check */
+		void checkBudget(uint32_t heapIndex)
+		{
+			HeapBudget &heap = heapBudgets[heapIndex];
+			VkDeviceSize usage = heap.blockBytes + heap.externalUsage;
+			bool exceeded = usage > (VkDeviceSize)((double)heap.budget * budgetThreshold);
+			if (exceeded && !heap.exceeded && budgetCallback)
+			{
+				budgetCallback(heapIndex, usage, heap.budget);
+			}
+			heap.exceeded = exceeded;
+		}
+
+		/** @brief Default block size, limited to an eighth of the heap for small heaps */
+		VkDeviceSize preferredBlockSize(uint32_t memoryTypeIndex)
+		{
+			VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+			return std::min(blockSize, std::max<VkDeviceSize>(heapSize / 8, 1));
+		}
+
+		VkResult createBlock(uint32_t memoryTypeIndex, VkDeviceSize size, bool dedicated, MemoryBlock **block)
+		{
+			VkMemoryAllocateInfo memAlloc = vks::initializers::memoryAllocateInfo();
+			memAlloc.allocationSize = size;
+			memAlloc.memoryTypeIndex = memoryTypeIndex;
+			VkDeviceMemory memory;
+			VkResult result = vkAllocateMemory(device, &memAlloc, nullptr, &memory);
+			if (result != VK_SUCCESS)
+			{
+				return result;
+			}
+
+			MemoryBlock *newBlock = new MemoryBlock();
+			newBlock->allocator = this;
+			newBlock->memory = memory;
+			newBlock->size = size;
+			newBlock->memoryTypeIndex = memoryTypeIndex;
+			newBlock->dedicated = dedicated;
+			newBlock->ranges.push_back({ 0, size, AllocationType::Free });
+
+			// Host visible blocks stay mapped for their whole lifetime, as a memory object can only be mapped once
+			if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+			{
+				VK_CHECK_RESULT(vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &newBlock->mapped));
+			}
+
+			pools[memoryTypeIndex].push_back(newBlock);
+			*block = newBlock;
+
+			uint32_t heapIndex = memoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+			heapBudgets[heapIndex].blockBytes += size;
+			checkBudget(heapIndex);
+			return VK_SUCCESS;
+		}
+
+		void destroyBlock(MemoryBlock *block)
+		{
+			uint32_t heapIndex = memoryProperties.memoryTypes[block->memoryTypeIndex].heapIndex;
+			heapBudgets[heapIndex].blockBytes -= block->size;
+			checkBudget(heapIndex);
+			if (block->mapped)
+			{
+				vkUnmapMemory(device, block->memory);
+			}
+			vkFreeMemory(device, block->memory, nullptr);
+			delete block;
+		}
+	};
+}
@@ -26,6 +26,7 @@
 #include "VulkanDevice.hpp"
 #include "VulkanBuffer.hpp"
 #include "VulkanTexture.hpp"
+#include "trace.hpp"
 
 #if defined(__ANDROID__)
 #include <android/asset_manager.h>
@@ -161,13 +162,8 @@ namespace vks
             assert(device);
 
             texArray.destroy();
-            vkDestroyBuffer(device, vertices.buffer, nullptr);
-            vkFreeMemory(device, vertices.memory, nullptr);
-            if (indices.buffer != VK_NULL_HANDLE)
-            {
-                vkDestroyBuffer(device, indices.buffer, nullptr);
-                vkFreeMemory(device, indices.memory, nullptr);
-            }
+            vertices.destroy();
+            indices.destroy();
         }
         static bool compareNoCase( const std::string& s1, const std::string& s2 ) {
             return strcasecmp( s1.c_str(), s2.c_str() ) <= 0;
@@ -184,6 +180,7 @@ namespace vks
         */
         bool loadFromFile(const std::string& filename, vks::VertexLayout layout, vks::ModelCreateInfo *createInfo, vks::VulkanDevice *device, VkQueue copyQueue, const int flags = defaultFlags)
         {
+            VKS_TRACE_ZONE("Model load");
             this->device = device->logicalDevice;
 
             Assimp::Importer Importer;
@@ -236,212 +233,9 @@ namespace vks
                 }
 
                 if (mapDic.size()>0){
+                    //decoded and resized on a thread pool while earlier layers are uploaded
                     uint32_t texSize = 1024;
-
-                    //create texture array
-                    texArray.format = VK_FORMAT_R8G8B8A8_UNORM;
-                    texArray.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-                    texArray.layerCount = mapDic.size();
-                    texArray.width = texArray.height = texSize;
-                    texArray.mipLevels = floor(log2(std::max(texArray.width, texArray.height))) + 1;
-                    texArray.device = device;
-
-                    VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
-                    imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
-                    imageCreateInfo.format = texArray.format;
-                    imageCreateInfo.mipLevels = texArray.mipLevels;
-                    imageCreateInfo.arrayLayers = texArray.layerCount;
-                    imageCreateInfo.samples = VK_SAMPLE_COUNT_1_BIT;
-                    imageCreateInfo.tiling = VK_IMAGE_TILING_OPTIMAL;
-                    imageCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-                    imageCreateInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-                    imageCreateInfo.extent = { texArray.width, texArray.height, 1 };
-                    imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
-                    VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &texArray.image));
-
-                    VkMemoryRequirements memReqs = {};
-                    VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-                    vkGetImageMemoryRequirements(device->logicalDevice, texArray.image, &memReqs);
-                    memAllocInfo.allocationSize = memReqs.size;
-                    memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-                    VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &texArray.deviceMemory));
-                    VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, texArray.image, texArray.deviceMemory, 0));
-
-                    for (int l = 0; l < mapDic.size(); l++) {
-                        Texture inTex;
-                        inTex.loadStbLinearNoSampling(mapDic[l].c_str(), device);
-
-                        VkCommandBuffer blitFirstMipCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-                        VkImageBlit firstMipBlit{};
-
-                        // Source
-                        firstMipBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                        firstMipBlit.srcSubresource.layerCount = 1;
-                        firstMipBlit.srcSubresource.mipLevel = 0;
-                        firstMipBlit.srcSubresource.baseArrayLayer = 0;
-                        firstMipBlit.srcOffsets[1].x = inTex.width;
-                        firstMipBlit.srcOffsets[1].y = inTex.height;
-                        firstMipBlit.srcOffsets[1].z = 1;
-
-                        // Destination
-                        firstMipBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                        firstMipBlit.dstSubresource.layerCount = 1;
-                        firstMipBlit.dstSubresource.mipLevel = 0;
-                        firstMipBlit.dstSubresource.baseArrayLayer = l;
-                        firstMipBlit.dstOffsets[1].x = texArray.width;
-                        firstMipBlit.dstOffsets[1].y = texArray.height;
-                        firstMipBlit.dstOffsets[1].z = 1;
-
-                        VkImageSubresourceRange firstMipSubRange = {};
-                        firstMipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                        firstMipSubRange.baseArrayLayer = l;
-                        firstMipSubRange.levelCount = 1;
-                        firstMipSubRange.layerCount = 1;
-
-                        // Transiton current array level to transfer dest
-                        vks::tools::setImageLayout(
-                            blitFirstMipCmd,
-                            texArray.image,
-                            VK_IMAGE_LAYOUT_UNDEFINED,
-                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                            firstMipSubRange,
-                            VK_PIPELINE_STAGE_TRANSFER_BIT,
-                            VK_PIPELINE_STAGE_HOST_BIT);
-
-                        // Blit from source texture
-                        vkCmdBlitImage(
-                            blitFirstMipCmd,
-                            inTex.image,
-                            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                            texArray.image,
-                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                            1,
-                            &firstMipBlit,
-                            VK_FILTER_LINEAR);
-
-                        //set layer ready for sampling
-                        vks::tools::setImageLayout(
-                            blitFirstMipCmd,
-                            texArray.image,
-                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                            texArray.imageLayout,
-                            firstMipSubRange);
-
-                        device->flushCommandBuffer(blitFirstMipCmd, copyQueue, true);
-
-                        vkDestroyImage(device->logicalDevice, inTex.image, nullptr);
-                        vkFreeMemory(device->logicalDevice, inTex.deviceMemory, nullptr);
-
-                        VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-                        // Copy down mips from n-1 to n
-                        for (int32_t i = 1; i < texArray.mipLevels; i++)
-                        {
-                            VkImageBlit imageBlit{};
-
-                            // Source
-                            imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                            imageBlit.srcSubresource.layerCount = 1;
-                            imageBlit.srcSubresource.mipLevel = i-1;
-                            imageBlit.srcSubresource.baseArrayLayer = l;
-                            imageBlit.srcOffsets[1].x = int32_t(texArray.width >> (i - 1));
-                            imageBlit.srcOffsets[1].y = int32_t(texArray.height >> (i - 1));
-                            imageBlit.srcOffsets[1].z = 1;
-
-                            // Destination
-                            imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                            imageBlit.dstSubresource.layerCount = 1;
-                            imageBlit.dstSubresource.mipLevel = i;
-                            imageBlit.dstSubresource.baseArrayLayer = l;
-                            imageBlit.dstOffsets[1].x = int32_t(texArray.width >> i);
-                            imageBlit.dstOffsets[1].y = int32_t(texArray.height >> i);
-                            imageBlit.dstOffsets[1].z = 1;
-
-                            VkImageSubresourceRange mipSubRange = {};
-                            mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                            mipSubRange.baseMipLevel = i;
-                            mipSubRange.baseArrayLayer = l;
-                            mipSubRange.levelCount = 1;
-                            mipSubRange.layerCount = 1;
-
-                            // Transiton current mip level to transfer dest
-                            vks::tools::setImageLayout(
-                                blitCmd,
-                                texArray.image,
-                                VK_IMAGE_LAYOUT_UNDEFINED,
-                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                mipSubRange,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT,
-                                VK_PIPELINE_STAGE_HOST_BIT);
-
-                            // Blit from previous level
-                            vkCmdBlitImage(
-                                blitCmd,
-                                texArray.image,
-                                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                                texArray.image,
-                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                1,
-                                &imageBlit,
-                                VK_FILTER_LINEAR);
-
-                            // Transiton current mip level to transfer source for read in next iteration
-                            vks::tools::setImageLayout(
-                                blitCmd,
-                                texArray.image,
-                                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                                mipSubRange,
-                                VK_PIPELINE_STAGE_HOST_BIT,
-                                VK_PIPELINE_STAGE_TRANSFER_BIT);
-                        }
-                        //set layer ready for sampling
-                        firstMipSubRange.levelCount = texArray.mipLevels;
-                        vks::tools::setImageLayout(
-                            blitFirstMipCmd,
-                            texArray.image,
-                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                            texArray.imageLayout,
-                            firstMipSubRange);
-                        device->flushCommandBuffer(blitCmd, copyQueue, true);
-                    }
-
-                    // Create samplers
-                    VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
-                    samplerCI.magFilter = VK_FILTER_LINEAR;
-                    samplerCI.minFilter = VK_FILTER_LINEAR;
-                    samplerCI.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-                    samplerCI.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-                    samplerCI.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-                    samplerCI.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-                    samplerCI.mipLodBias = 0.0f;
-                    samplerCI.compareOp = VK_COMPARE_OP_NEVER;
-                    samplerCI.minLod = 0.0f;
-                    samplerCI.maxLod = (float)texArray.mipLevels;
-                    samplerCI.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-                    if (device->features.samplerAnisotropy)
-                    {
-                        samplerCI.maxAnisotropy = device->properties.limits.maxSamplerAnisotropy;
-                        samplerCI.anisotropyEnable = VK_TRUE;
-                    }else{
-                        samplerCI.maxAnisotropy = 1.0;
-                        samplerCI.anisotropyEnable = VK_FALSE;
-                    }
-                    VK_CHECK_RESULT(vkCreateSampler(device->logicalDevice, &samplerCI, nullptr, &texArray.sampler));
-
-                    // Create image view
-                    VkImageViewCreateInfo viewCI = vks::initializers::imageViewCreateInfo();
-                    viewCI.image = texArray.image;
-                    viewCI.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
-                    viewCI.format = texArray.format;
-                    viewCI.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
-                    viewCI.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                    viewCI.subresourceRange.baseMipLevel = 0;
-                    viewCI.subresourceRange.baseArrayLayer = 0;
-                    viewCI.subresourceRange.layerCount = texArray.layerCount;
-                    viewCI.subresourceRange.levelCount = texArray.mipLevels;
-                    VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &texArray.view));
-                    texArray.updateDescriptor();
+                    texArray.buildFromImages(mapDic, texSize, VK_FORMAT_R8G8B8A8_UNORM, device, copyQueue);
                 }
 
                 parts.clear();
@@ -607,59 +401,9 @@ namespace vks
                 uint32_t vBufferSize = static_cast<uint32_t>(vertexBuffer.size()) * sizeof(float);
                 uint32_t iBufferSize = static_cast<uint32_t>(indexBuffer.size()) * sizeof(uint32_t);
 
-                // Use staging buffer to move vertex and index buffer to device local memory
-                // Create staging buffers
-                vks::Buffer vertexStaging, indexStaging;
-
-                // Vertex buffer
-                VK_CHECK_RESULT(device->createBuffer(
-                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                    &vertexStaging,
-                    vBufferSize,
-                    vertexBuffer.data()));
-
-                // Index buffer
-                VK_CHECK_RESULT(device->createBuffer(
-                    VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                    VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
-                    &indexStaging,
-                    iBufferSize,
-                    indexBuffer.data()));
-
-                // Create device local target buffers
-                // Vertex buffer
-                VK_CHECK_RESULT(device->createBuffer(
-                    VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                    &vertices,
-                    vBufferSize));
-
-                // Index buffer
-                VK_CHECK_RESULT(device->createBuffer(
-                    VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-                    VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-                    &indices,
-                    iBufferSize));
-
-                // Copy from staging buffers
-                VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-                VkBufferCopy copyRegion{};
-
-                copyRegion.size = vertices.size;
-                vkCmdCopyBuffer(copyCmd, vertexStaging.buffer, vertices.buffer, 1, &copyRegion);
-
-                copyRegion.size = indices.size;
-                vkCmdCopyBuffer(copyCmd, indexStaging.buffer, indices.buffer, 1, &copyRegion);
-
-                device->flushCommandBuffer(copyCmd, copyQueue);
-
-                // Destroy staging resources
-                vkDestroyBuffer(device->logicalDevice, vertexStaging.buffer, nullptr);
-                vkFreeMemory(device->logicalDevice, vertexStaging.memory, nullptr);
-                vkDestroyBuffer(device->logicalDevice, indexStaging.buffer, nullptr);
-                vkFreeMemory(device->logicalDevice, indexStaging.memory, nullptr);
+                // Create device local buffers, written directly on devices with host visible device local memory, staged otherwise
+                VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &vertices, vBufferSize, vertexBuffer.data()));
+                VK_CHECK_RESULT(device->createDeviceLocalBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &indices, iBufferSize, indexBuffer.data()));
 
                 return true;
             }
@@ -0,0 +1,335 @@
+/*
+* Vulkan gpu profiler
+*
+* Measures named scopes of command buffers with timestamp queries, using the same names as the
+* debug marker regions. Command buffers are recorded per swap chain image, so each image has its
+* own range of queries, resolved when the image is acquired again (its last frame has finished)
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <functional>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanInitializers.hpp"
+
+namespace vks
+{
+	class GpuProfiler
+	{
+	public:
+		/** @brief Timings of a named scope */
+		struct Scope
+		{
+			std::string name;
+			/** @brief Last measured duration in milliseconds */
+			double last = 0.0;
+			/** @brief Rolling history of measured durations in milliseconds, oldest values are overwritten */
+			std::vector<double> history;
+			/** @brief Position the next measurement is written to in history */
+			size_t next = 0;
+
+			/** @brief Average of the measurements in the history */
+			double average() const
+			{
+				if (history.empty())
+				{
+					return 0.0;
+				}
+				double sum = 0.0;
+				for (auto value : history)
+				{
+					sum += value;
+				}
+				return sum / history.size();
+			}
+
+			/** @brief Largest measurement in the history */
+			double max() const
+			{
+				return history.empty() ? 0.0 : *std::max_element(history.begin(), history.end());
+			}
+		};
+
+		/** @brief Number of measurements kept per scope */
+		uint32_t historySize = 120;
+		/** @brief Receives the destruction of the previous query range on resize, to run it once the frames in flight no longer use it (destroyed right away if not set) */
+		std::function<void(std::function<void()>)> deferDestruction;
+		/** @brief Submits the query resets, to share the queue's lock with the other submitters (vkQueueSubmit is called directly if not set) */
+		std::function<VkResult(VkQueue, uint32_t, const VkSubmitInfo*, VkFence)> queueSubmit;
+
+		/**
+		* Create the profiler
+		*
+		* @param device Logical device the queries are created on
+		* @param physicalDevice Physical device, used to check timestamp support and the timestamp period
+		* @param queueFamilyIndex Family of the queue the profiled command buffers are submitted to
+		* @param imageCount Number of swap chain images (one query range each)
+		* @param maxScopes Maximum number of distinct scopes, further scopes are not measured
+		*/
+		GpuProfiler(VkDevice device, VkPhysicalDevice physicalDevice, uint32_t queueFamilyIndex, uint32_t imageCount, uint32_t maxScopes = 32)
+		{
+			this->device = device;
+			this->queueFamilyIndex = queueFamilyIndex;
+			this->maxScopes = maxScopes;
+
+			VkPhysicalDeviceProperties properties;
+			vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+			timestampPeriod = properties.limits.timestampPeriod;
+			uint32_t queueFamilyCount;
+			vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, nullptr);
+			std::vector<VkQueueFamilyProperties> queueFamilyProperties(queueFamilyCount);
+			vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &queueFamilyCount, queueFamilyProperties.data());
+			timestampValidBits = queueFamilyProperties[queueFamilyIndex].timestampValidBits;
+
+			resize(imageCount);
+		}
+
+		~GpuProfiler()
+		{
+			destroyQueries(false);
+		}
+
+		/** @brief True if the queue supports timestamps, scopes are ignored otherwise */
+		bool supported() const
+		{
+			return (timestampValidBits > 0) && (timestampPeriod > 0.0f);
+		}
+
+		/**
+		* Recreate the query ranges for a new swap chain image count
+		*
+		* @note Command buffers containing scopes have to be rebuilt, the previous queries are destroyed through deferDestruction if set
+		*/
+		void resize(uint32_t newImageCount)
+		{
+			destroyQueries(true);
+			imageCount = newImageCount;
+			imagePending.assign(imageCount, false);
+			if (!supported() || (imageCount == 0))
+			{
+				return;
+			}
+
+			VkQueryPoolCreateInfo queryPoolCI = {};
+			queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+			queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+			queryPoolCI.queryCount = imageCount * maxScopes * 2;
+			VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCI, nullptr, &queryPool));
+
+			// Each query range gets its own command pool, so a previous range can be released while its frames are still in flight
+			VkCommandPoolCreateInfo cmdPoolInfo = {};
+			cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+			cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
+
+			// Queries are reset outside of the images' command buffers, as scopes may be inside render passes
+			resetCmdBuffers.resize(imageCount);
+			VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, imageCount);
+			VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, resetCmdBuffers.data()));
+			VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+			for (uint32_t i = 0; i < imageCount; i++)
+			{
+				VK_CHECK_RESULT(vkBeginCommandBuffer(resetCmdBuffers[i], &cmdBufInfo));
+				vkCmdResetQueryPool(resetCmdBuffers[i], queryPool, i * maxScopes * 2, maxScopes * 2);
+				VK_CHECK_RESULT(vkEndCommandBuffer(resetCmdBuffers[i]));
+			}
+		}
+
+		/**
+		* Resolve the timings of the image's previous frame and reset its queries
+		*
+		* @param queue Queue the frame is submitted to, the reset is submitted ahead of the frame's command buffers
+		* @param imageIndex Index of the acquired swap chain image
+		*
+		* @note The previous frame rendering to the image must have finished, results are read without waiting
+		*/
+		void beginFrame(VkQueue queue, uint32_t imageIndex)
+		{
+			if ((queryPool == VK_NULL_HANDLE) || (imageIndex >= imageCount))
+			{
+				return;
+			}
+			if (imagePending[imageIndex])
+			{
+				resolve(imageIndex);
+			}
+
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &resetCmdBuffers[imageIndex];
+			if (queueSubmit)
+			{
+				VK_CHECK_RESULT(queueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+			}
+			else
+			{
+				VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+			}
+			imagePending[imageIndex] = true;
+		}
+
+		/**
+		* Start a named scope, use the name of the matching debug marker region
+		*
+		* @param commandBuffer Command buffer rendering to the swap chain image
+		* @param imageIndex Index of the swap chain image the command buffer renders to
+		* @param name Name of the scope
+		*/
+		void beginScope(VkCommandBuffer commandBuffer, uint32_t imageIndex, const std::string &name)
+		{
+			uint32_t query;
+			if (getQuery(imageIndex, name, query))
+			{
+				vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, query);
+			}
+		}
+
+		/**
+		* End a named scope started with beginScope
+		*
+		* @param commandBuffer Command buffer rendering to the swap chain image
+		* @param imageIndex Index of the swap chain image the command buffer renders to
+		* @param name Name of the scope
+		*/
+		void endScope(VkCommandBuffer commandBuffer, uint32_t imageIndex, const std::string &name)
+		{
+			uint32_t query;
+			if (getQuery(imageIndex, name, query))
+			{
+				vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, query + 1);
+			}
+		}
+
+		/** @brief Scopes in order of first use */
+		const std::vector<Scope>& getScopes() const
+		{
+			return scopes;
+		}
+
+		/** @brief Find a scope by name, nullptr if it has not been used yet */
+		const Scope* getScope(const std::string &name) const
+		{
+			for (auto &scope : scopes)
+			{
+				if (scope.name == name)
+				{
+					return &scope;
+				}
+			}
+			return nullptr;
+		}
+
+	private:
+		VkDevice device;
+		uint32_t queueFamilyIndex;
+		uint32_t maxScopes;
+		uint32_t imageCount = 0;
+		float timestampPeriod = 0.0f;
+		uint32_t timestampValidBits = 0;
+		VkQueryPool queryPool = VK_NULL_HANDLE;
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		std::vector<VkCommandBuffer> resetCmdBuffers;
+		// True if the image's queries have been reset and may have been written by a submitted frame
+		std::vector<bool> imagePending;
+		std::vector<Scope> scopes;
+
+		// Index of the begin query of a scope for an image, the end query follows it
+		bool getQuery(uint32_t imageIndex, const std::string &name, uint32_t &query)
+		{
+			if ((queryPool == VK_NULL_HANDLE) || (imageIndex >= imageCount))
+			{
+				return false;
+			}
+			uint32_t scopeIndex = 0;
+			while ((scopeIndex < scopes.size()) && (scopes[scopeIndex].name != name))
+			{
+				scopeIndex++;
+			}
+			if (scopeIndex == scopes.size())
+			{
+				if (scopes.size() >= maxScopes)
+				{
+					return false;
+				}
+				Scope scope;
+				scope.name = name;
+				scopes.push_back(scope);
+			}
+			query = (imageIndex * maxScopes + scopeIndex) * 2;
+			return true;
+		}
+
+		void resolve(uint32_t imageIndex)
+		{
+			if (scopes.empty())
+			{
+				return;
+			}
+			// Value and availability per query, scopes not recorded into the image's command buffer stay unavailable
+			uint32_t queryCount = static_cast<uint32_t>(scopes.size()) * 2;
+			std::vector<uint64_t> results(queryCount * 2);
+			VkResult result = vkGetQueryPoolResults(device, queryPool, imageIndex * maxScopes * 2, queryCount, results.size() * sizeof(uint64_t), results.data(), 2 * sizeof(uint64_t), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT);
+			if ((result != VK_SUCCESS) && (result != VK_NOT_READY))
+			{
+				VK_CHECK_RESULT(result);
+			}
+			uint64_t mask = (timestampValidBits >= 64) ? ~0ULL : ((1ULL << timestampValidBits) - 1);
+			for (size_t i = 0; i < scopes.size(); i++)
+			{
+				const uint64_t *begin = &results[i * 4];
+				const uint64_t *end = &results[i * 4 + 2];
+				if ((begin[1] == 0) || (end[1] == 0))
+				{
+					continue;
+				}
+				double duration = (double)((end[0] - begin[0]) & mask) * timestampPeriod / 1000000.0;
+				Scope &scope = scopes[i];
+				scope.last = duration;
+				if (scope.history.size() < historySize)
+				{
+					scope.history.push_back(duration);
+				}
+				else if (historySize > 0)
+				{
+					scope.history[scope.next % historySize] = duration;
+				}
+				scope.next = (scope.next + 1) % std::max(historySize, 1u);
+			}
+		}
+
+		// Destroying the command pool also frees the reset command buffers
+		void destroyQueries(bool defer)
+		{
+			if (queryPool == VK_NULL_HANDLE)
+			{
+				return;
+			}
+			VkDevice oldDevice = device;
+			VkQueryPool oldQueryPool = queryPool;
+			VkCommandPool oldCommandPool = commandPool;
+			std::function<void()> destroyOld = [oldDevice, oldQueryPool, oldCommandPool]()
+			{
+				vkDestroyCommandPool(oldDevice, oldCommandPool, nullptr);
+				vkDestroyQueryPool(oldDevice, oldQueryPool, nullptr);
+			};
+			if (defer && deferDestruction)
+			{
+				deferDestruction(destroyOld);
+			}
+			else
+			{
+				destroyOld();
+			}
+			resetCmdBuffers.clear();
+			queryPool = VK_NULL_HANDLE;
+			commandPool = VK_NULL_HANDLE;
+		}
+	};
+}
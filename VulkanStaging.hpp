@@ -0,0 +1,699 @@
+/*
+* Vulkan staging ring
+*
+* Persistently mapped upload buffer shared by the asset loaders, copies are recorded into shared
+* transfer command buffers that are submitted in batches
+*
+* Upload tokens track the batch that wrote a resource and carry the queue family ownership
+* transfer for rings that run on a dedicated transfer queue
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <mutex>
+#include <string.h>
+#include <assert.h>
+
+#include "vulkan/vulkan.h"
+#include "VulkanTools.h"
+#include "VulkanMemory.hpp"
+
+namespace vks
+{
+	/** @brief Location of data written into the staging ring, to be used as the source of a copy command */
+	struct StagingRegion
+	{
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		/** @brief Host address of the region (persistently mapped) */
+		void *mapped = nullptr;
+	};
+
+	struct StagingRing;
+
+	/**
+	* @brief Completion token of an asynchronous upload
+	*
+	* Identifies the staging batch that wrote a resource. If the upload ran on another queue family, the token also
+	* holds the barriers that acquire ownership on the consuming queue, they are recorded by acquire().
+	* acquire() does not block, the consuming queue is ordered after the upload by submission order on the same family
+	* and by the semaphore of the batch otherwise (see StagingRing::takeAcquiredSemaphores).
+	*/
+	struct UploadToken
+	{
+		StagingRing *ring = nullptr;
+		/** @brief Serial of the staging batch the upload was recorded into */
+		uint64_t serial = 0;
+		/** @brief Ownership acquire barriers to record on the consuming queue */
+		std::vector<VkBufferMemoryBarrier> bufferBarriers;
+		std::vector<VkImageMemoryBarrier> imageBarriers;
+
+		/** @brief Returns true if the token refers to an upload that has not been acquired yet */
+		bool valid() const { return ring != nullptr; }
+		/** @brief Returns true if the upload has finished executing (non blocking) */
+		bool ready();
+		/** @brief Submit the upload if still pending and block until it has finished executing */
+		void wait();
+		/**
+		* Submit the upload if still pending and record the ownership acquire barriers
+		*
+		* @param commandBuffer Command buffer of the queue family consuming the resource, recorded outside of a render pass
+		*
+		* @note Call once before the first use of the resource, the token is reset afterwards
+		* @note For uploads from another queue family the submission of commandBuffer must wait on the semaphores returned by the ring's takeAcquiredSemaphores
+		*/
+		void acquire(VkCommandBuffer commandBuffer);
+	};
+
+	/**
+	* @brief Ring of host visible upload memory with batched, fence tracked transfer submissions
+	*
+	* Loaders stage their data with stage() and record copies into commandBuffer(). Nothing is submitted
+	* until submit() is called or the ring runs out of space, so loading many assets costs only a few submits.
+	* Ring space is reclaimed once the fence of the batch that used it has signaled.
+	*
+	* @note Methods lock the ring, callers recording into commandBuffer() from several threads must hold mutex while doing so
+	*/
+	struct StagingRing
+	{
+		/** @brief Command buffer and ring range of one submission */
+		struct Batch
+		{
+			VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+			VkFence fence = VK_NULL_HANDLE;
+			/** @brief Serial of the batch, one higher than the previously submitted one */
+			uint64_t serial = 0;
+			/** @brief Ring position up to which the batch has consumed space, reclaimed once the fence has signaled */
+			uint64_t end = 0;
+			/** @brief Temporary buffers for uploads that are larger than the ring */
+			std::vector<std::pair<VkBuffer, vks::Allocation>> overflow;
+			/** @brief Signaled by the batch if it releases resources to another queue family, created on demand */
+			VkSemaphore semaphore = VK_NULL_HANDLE;
+			/** @brief Set once a consumer waits on the semaphore, which is then owned by the consumer */
+			bool semaphoreClaimed = false;
+		};
+
+		VkDevice device;
+		VkQueue queue;
+		uint32_t queueFamilyIndex;
+		vks::MemoryAllocator *allocator;
+
+		VkBuffer buffer = VK_NULL_HANDLE;
+		vks::Allocation allocation;
+		VkDeviceSize size = 0;
+		/** @brief Device limit for the offsets of buffer to image copies, combined with the texel size by imageCopyAlignment */
+		VkDeviceSize optimalBufferCopyOffsetAlignment = 1;
+
+		/** @brief Lock of the queue shared with other submitters (e.g. the render thread), held for each vkQueueSubmit of the ring (nullptr if the ring is the only submitter) */
+		std::mutex *queueMutex = nullptr;
+
+		/** @brief Number of batches submitted so far, equals the serial of the last submitted batch */
+		uint64_t submitCount = 0;
+		/** @brief Serial of the last batch known to have finished executing */
+		uint64_t completedSerial = 0;
+
+		/** @brief Guards the ring, recursive so a caller can hold it across stage() and the recording of its copy */
+		std::recursive_mutex mutex;
+
+		/**
+		* Default constructor
+		*
+		* @param device Logical device
+		* @param allocator Allocator the ring buffer is taken from
+		* @param queue Queue the transfer batches are submitted to
+		* @param queueFamilyIndex Family index of the queue
+		* @param size Size of the ring buffer in bytes
+		* @param (Optional) optimalBufferCopyOffsetAlignment Device limit of the same name (Defaults to 1)
+		* @param (Optional) queueMutex Lock of the queue, required if other code submits to the same queue from another thread
+		*/
+		StagingRing(VkDevice device, vks::MemoryAllocator *allocator, VkQueue queue, uint32_t queueFamilyIndex, VkDeviceSize size, VkDeviceSize optimalBufferCopyOffsetAlignment = 1, std::mutex *queueMutex = nullptr)
+		{
+			this->queueMutex = queueMutex;
+			this->device = device;
+			this->allocator = allocator;
+			this->queue = queue;
+			this->queueFamilyIndex = queueFamilyIndex;
+			this->size = size;
+			this->optimalBufferCopyOffsetAlignment = std::max<VkDeviceSize>(optimalBufferCopyOffsetAlignment, 1);
+
+			VkCommandPoolCreateInfo cmdPoolInfo = vks::initializers::commandPoolCreateInfo();
+			cmdPoolInfo.queueFamilyIndex = queueFamilyIndex;
+			cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+			VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &commandPool));
+
+			VK_CHECK_RESULT(createHostBuffer(size, &buffer, &allocation));
+		}
+
+		/**
+		* Default destructor
+		*
+		* @note Waits for submitted batches to finish, copies that were never submitted are discarded as their targets may already be destroyed
+		*/
+		~StagingRing()
+		{
+			if (recording)
+			{
+				VK_CHECK_RESULT(vkEndCommandBuffer(current.commandBuffer));
+				for (auto &overflow : current.overflow)
+				{
+					vkDestroyBuffer(device, overflow.first, nullptr);
+					allocator->free(overflow.second);
+				}
+				if (current.semaphore != VK_NULL_HANDLE)
+				{
+					vkDestroySemaphore(device, current.semaphore, nullptr);
+					current.semaphore = VK_NULL_HANDLE;
+				}
+				freeBatches.push_back(current);
+				recording = false;
+			}
+			finish();
+			for (auto semaphore : acquiredSemaphores)
+			{
+				vkDestroySemaphore(device, semaphore, nullptr);
+			}
+			for (auto &batch : freeBatches)
+			{
+				vkFreeCommandBuffers(device, commandPool, 1, &batch.commandBuffer);
+				vkDestroyFence(device, batch.fence, nullptr);
+			}
+			vkDestroyCommandPool(device, commandPool, nullptr);
+			vkDestroyBuffer(device, buffer, nullptr);
+			allocator->free(allocation);
+		}
+
+		/**
+		* Reserve space in the ring
+		*
+		* @param size Number of bytes to reserve
+		* @param alignment (Optional) Required alignment of the region offset (Defaults to 4, enough for buffer copies, use imageCopyAlignment for buffer to image copies)
+		*
+		* @return Region to write the data to, valid until the batch recording the copy has completed
+		*
+		* @note Submits the current batch and waits for older ones if the ring is full
+		*/
+		StagingRegion allocate(VkDeviceSize size, VkDeviceSize alignment = 4)
+		{
+			std::lock_guard<std::recursive_mutex> lock(mutex);
+			StagingRegion region;
+			region.size = size;
+
+			if (size > this->size)
+			{
+				// Larger than the whole ring, use a temporary buffer that lives as long as the current batch
+				Batch &batch = currentBatch();
+				std::pair<VkBuffer, vks::Allocation> overflow;
+				VK_CHECK_RESULT(createHostBuffer(size, &overflow.first, &overflow.second));
+				batch.overflow.push_back(overflow);
+				region.buffer = overflow.first;
+				region.offset = 0;
+				region.mapped = overflow.second.mapped;
+				return region;
+			}
+
+			uint64_t start = 0;
+			while (!reserve(size, alignment, &start))
+			{
+				// Ring is full, make room by submitting pending copies and waiting for the oldest batch
+				if (recording)
+				{
+					submit();
+				}
+				assert(!inFlight.empty());
+				VK_CHECK_RESULT(vkWaitForFences(device, 1, &inFlight.front().fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+				reclaim();
+			}
+
+			// Make sure a batch is open so the space is released with it
+			currentBatch();
+
+			region.buffer = buffer;
+			region.offset = start % this->size;
+			region.mapped = static_cast<uint8_t*>(allocation.mapped) + region.offset;
+			return region;
+		}
+
+		/**
+		* Copy data into the ring
+		*
+		* @param data Pointer to the data to stage
+		* @param size Size of the data in bytes
+		* @param alignment (Optional) Required alignment of the region offset (Defaults to 4, use imageCopyAlignment for buffer to image copies)
+		*
+		* @return Region holding the data
+		*/
+		StagingRegion stage(const void *data, VkDeviceSize size, VkDeviceSize alignment = 4)
+		{
+			StagingRegion region = allocate(size, alignment);
+			memcpy(region.mapped, data, size);
+			return region;
+		}
+
+		/**
+		* Stage data and record a copy into a buffer
+		*
+		* @param data Pointer to the data to upload
+		* @param size Size of the data in bytes
+		* @param dstBuffer Destination buffer (must have the TRANSFER_DST usage flag set)
+		* @param dstOffset (Optional) Offset into the destination buffer
+		*/
+		void copyToBuffer(const void *data, VkDeviceSize size, VkBuffer dstBuffer, VkDeviceSize dstOffset = 0)
+		{
+			std::lock_guard<std::recursive_mutex> lock(mutex);
+			StagingRegion region = stage(data, size, 4);
+			VkBufferCopy copyRegion = {};
+			copyRegion.srcOffset = region.offset;
+			copyRegion.dstOffset = dstOffset;
+			copyRegion.size = size;
+			vkCmdCopyBuffer(commandBuffer(), region.buffer, dstBuffer, 1, &copyRegion);
+		}
+
+		/**
+		* Alignment of a region used as the source of a buffer to image copy
+		*
+		* @param texelBlockSize Size in bytes of a texel (or compressed block) of the image format
+		*
+		* @return Least common multiple of the texel block size, 4 and optimalBufferCopyOffsetAlignment
+		*
+		* @note Copy offsets must be multiples of the texel block size, which is not a power of two for formats like R32G32B32
+		*/
+		VkDeviceSize imageCopyAlignment(VkDeviceSize texelBlockSize) const
+		{
+			VkDeviceSize alignment = lcm(std::max<VkDeviceSize>(texelBlockSize, 1), 4);
+			return lcm(alignment, optimalBufferCopyOffsetAlignment);
+		}
+
+		/** @brief Command buffer of the current batch, copies and layout transitions of the loaders are recorded into it */
+		VkCommandBuffer commandBuffer()
+		{
+			std::lock_guard<std::recursive_mutex> lock(mutex);
+			return currentBatch().commandBuffer;
+		}
+
+		/** @brief Returns true if copies have been recorded that are not submitted yet */
+		bool pending()
+		{
+			std::lock_guard<std::recursive_mutex> lock(mutex);
+			return recording;
+		}
+
+		/** @brief Serial the batch currently being recorded will be submitted with, opens a batch if none is recording */
+		uint64_t recordingSerial()
+		{
+			std::lock_guard<std::recursive_mutex> lock(mutex);
+			currentBatch();
+			return current.serial;
+		}
+
+		/** @brief Returns true if the batch with the given serial has finished executing (non blocking) */
+		bool isComplete(uint64_t serial)
+		{
+			std::lock_guard<std::recursive_mutex> lock(mutex);
+			if (serial <= completedSerial)
+			{
+				return true;
+			}
+			reclaim();
+			return serial <= completedSerial;
+		}
+
+		/**
+		* Block until the batch with the given serial has finished executing
+		*
+		* @param serial Serial returned by recordingSerial(), the batch is submitted first if it is still being recorded
+		*/
+		void wait(uint64_t serial)
+		{
+			std::lock_guard<std::recursive_mutex> lock(mutex);
+			if (serial > submitCount)
+			{
+				submit();
+			}
+			while (completedSerial < serial)
+			{
+				assert(!inFlight.empty());
+				VK_CHECK_RESULT(vkWaitForFences(device, 1, &inFlight.front().fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+				reclaim();
+			}
+		}
+
+		/**
+		* Release a buffer written by the current batch to another queue family
+		*
+		* @param token Token receiving the matching acquire barrier
+		* @param buffer Buffer written by the copies of the current batch
+		* @param offset Start of the written range
+		* @param size Size of the written range
+		* @param dstQueueFamilyIndex Queue family that will use the buffer
+		*/
+		void release(UploadToken &token, VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, uint32_t dstQueueFamilyIndex)
+		{
+			std::lock_guard<std::recursive_mutex> lock(mutex);
+			token.ring = this;
+			token.serial = recordingSerial();
+			if (dstQueueFamilyIndex == queueFamilyIndex)
+			{
+				return;
+			}
+			signalSemaphore();
+
+			VkBufferMemoryBarrier barrier = vks::initializers::bufferMemoryBarrier();
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			barrier.srcQueueFamilyIndex = queueFamilyIndex;
+			barrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+			barrier.buffer = buffer;
+			barrier.offset = offset;
+			barrier.size = size;
+			vkCmdPipelineBarrier(current.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			token.bufferBarriers.push_back(barrier);
+		}
+
+		/**
+		* Transition an image written by the current batch and release it to another queue family
+		*
+		* @param token Token receiving the matching acquire barrier
+		* @param image Image written by the copies of the current batch
+		* @param subresourceRange Subresources written
+		* @param oldLayout Layout the image was written in
+		* @param newLayout Layout the image will be used in
+		* @param dstQueueFamilyIndex Queue family that will use the image
+		*
+		* @note The layout transition is part of the ownership transfer and is repeated by the acquire barrier
+		*/
+		void release(UploadToken &token, VkImage image, VkImageSubresourceRange subresourceRange, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t dstQueueFamilyIndex)
+		{
+			std::lock_guard<std::recursive_mutex> lock(mutex);
+			token.ring = this;
+			token.serial = recordingSerial();
+
+			VkImageMemoryBarrier barrier = vks::initializers::imageMemoryBarrier();
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.oldLayout = oldLayout;
+			barrier.newLayout = newLayout;
+			barrier.image = image;
+			barrier.subresourceRange = subresourceRange;
+			if (dstQueueFamilyIndex == queueFamilyIndex)
+			{
+				// Same family, a plain layout transition is enough
+				barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+				vkCmdPipelineBarrier(current.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+				return;
+			}
+			signalSemaphore();
+
+			barrier.dstAccessMask = 0;
+			barrier.srcQueueFamilyIndex = queueFamilyIndex;
+			barrier.dstQueueFamilyIndex = dstQueueFamilyIndex;
+			vkCmdPipelineBarrier(current.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+			token.imageBarriers.push_back(barrier);
+		}
+
+		/**
+		* Make sure the consumer of an upload is ordered after it, without blocking
+		*
+		* @param serial Serial of the batch that recorded the upload, the batch is submitted first if it is still being recorded
+		*
+		* @note If the batch released resources to another queue family and is still executing, its semaphore is added to the ones returned by takeAcquiredSemaphores
+		*/
+		void claim(uint64_t serial)
+		{
+			std::lock_guard<std::recursive_mutex> lock(mutex);
+			if (serial > submitCount)
+			{
+				submit();
+			}
+			for (auto &batch : inFlight)
+			{
+				if ((batch.serial == serial) && (batch.semaphore != VK_NULL_HANDLE) && !batch.semaphoreClaimed)
+				{
+					batch.semaphoreClaimed = true;
+					acquiredSemaphores.push_back(batch.semaphore);
+				}
+			}
+		}
+
+		/**
+		* Take the semaphores of the batches claimed since the last call
+		*
+		* @param semaphores Receives the semaphores, the next submission of the consuming queue must wait on them
+		*
+		* @note Ownership of the semaphores goes to the caller, they must be destroyed once the waiting submission has finished executing
+		*/
+		void takeAcquiredSemaphores(std::vector<VkSemaphore> &semaphores)
+		{
+			std::lock_guard<std::recursive_mutex> lock(mutex);
+			semaphores.insert(semaphores.end(), acquiredSemaphores.begin(), acquiredSemaphores.end());
+			acquiredSemaphores.clear();
+		}
+
+		/**
+		* Submit the copies recorded so far
+		*
+		* @note Does not wait for the copies to finish, later submissions to the same queue see the uploaded data
+		*/
+		void submit()
+		{
+			std::lock_guard<std::recursive_mutex> lock(mutex);
+			if (!recording)
+			{
+				return;
+			}
+
+			Batch &batch = current;
+
+			// Make the transfer writes available to everything submitted after this batch
+			VkMemoryBarrier memoryBarrier = vks::initializers::memoryBarrier();
+			memoryBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			memoryBarrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT | VK_ACCESS_MEMORY_WRITE_BIT;
+			vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &memoryBarrier, 0, nullptr, 0, nullptr);
+
+			VK_CHECK_RESULT(vkEndCommandBuffer(batch.commandBuffer));
+
+			VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+			submitInfo.commandBufferCount = 1;
+			submitInfo.pCommandBuffers = &batch.commandBuffer;
+			if (batch.semaphore != VK_NULL_HANDLE)
+			{
+				submitInfo.signalSemaphoreCount = 1;
+				submitInfo.pSignalSemaphores = &batch.semaphore;
+			}
+			{
+				std::unique_lock<std::mutex> queueLock;
+				if (queueMutex)
+				{
+					queueLock = std::unique_lock<std::mutex>(*queueMutex);
+				}
+				VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, batch.fence));
+			}
+			submitCount++;
+
+			batch.end = head;
+			inFlight.push_back(batch);
+			current = Batch();
+			recording = false;
+
+			reclaim();
+		}
+
+		/** @brief Submit pending copies and wait until all batches have finished executing */
+		void finish()
+		{
+			std::lock_guard<std::recursive_mutex> lock(mutex);
+			submit();
+			while (!inFlight.empty())
+			{
+				VK_CHECK_RESULT(vkWaitForFences(device, 1, &inFlight.front().fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+				reclaim();
+			}
+		}
+
+		/** @brief Release the ring space and command buffers of all batches that have finished executing (non blocking) */
+		void reclaim()
+		{
+			std::lock_guard<std::recursive_mutex> lock(mutex);
+			while (!inFlight.empty() && (vkGetFenceStatus(device, inFlight.front().fence) == VK_SUCCESS))
+			{
+				Batch &batch = inFlight.front();
+				tail = batch.end;
+				completedSerial = batch.serial;
+				for (auto &overflow : batch.overflow)
+				{
+					vkDestroyBuffer(device, overflow.first, nullptr);
+					allocator->free(overflow.second);
+				}
+				batch.overflow.clear();
+				// A claimed semaphore belongs to its consumer, an unclaimed one has no pending wait and can't be reset
+				if ((batch.semaphore != VK_NULL_HANDLE) && !batch.semaphoreClaimed)
+				{
+					vkDestroySemaphore(device, batch.semaphore, nullptr);
+				}
+				batch.semaphore = VK_NULL_HANDLE;
+				batch.semaphoreClaimed = false;
+				VK_CHECK_RESULT(vkResetCommandBuffer(batch.commandBuffer, 0));
+				VK_CHECK_RESULT(vkResetFences(device, 1, &batch.fence));
+				freeBatches.push_back(batch);
+				inFlight.pop_front();
+			}
+		}
+
+	private:
+		VkCommandPool commandPool = VK_NULL_HANDLE;
+		/** @brief Batch currently being recorded */
+		Batch current;
+		bool recording = false;
+		std::deque<Batch> inFlight;
+		std::vector<Batch> freeBatches;
+		/** @brief Semaphores of claimed batches not yet taken by the consumer */
+		std::vector<VkSemaphore> acquiredSemaphores;
+		/** @brief Ring positions, monotonically increasing (physical offset is position modulo size) */
+		uint64_t head = 0;
+		uint64_t tail = 0;
+
+		Batch &currentBatch()
+		{
+			if (!recording)
+			{
+				if (!freeBatches.empty())
+				{
+					current = freeBatches.back();
+					freeBatches.pop_back();
+				}
+				else
+				{
+					VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(commandPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, 1);
+					VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, &current.commandBuffer));
+					VkFenceCreateInfo fenceInfo = vks::initializers::fenceCreateInfo(VK_FLAGS_NONE);
+					VK_CHECK_RESULT(vkCreateFence(device, &fenceInfo, nullptr, &current.fence));
+				}
+				VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+				cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+				VK_CHECK_RESULT(vkBeginCommandBuffer(current.commandBuffer, &cmdBufInfo));
+				current.serial = submitCount + 1;
+				recording = true;
+			}
+			return current;
+		}
+
+		/** @brief Have the batch being recorded signal its semaphore on submit */
+		void signalSemaphore()
+		{
+			if (current.semaphore == VK_NULL_HANDLE)
+			{
+				VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+				VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &current.semaphore));
+			}
+		}
+
+		/** @brief Try to take size bytes from the ring, regions never wrap around the end of the buffer */
+		bool reserve(VkDeviceSize size, VkDeviceSize alignment, uint64_t *start)
+		{
+			uint64_t base = head - (head % this->size);
+			VkDeviceSize offset = vks::MemoryBlock::alignUp(head % this->size, alignment);
+			if (offset + size > this->size)
+			{
+				// Skip the remainder of the buffer and continue at its start
+				base += this->size;
+				offset = 0;
+			}
+			if ((base + offset + size) - tail > this->size)
+			{
+				return false;
+			}
+			*start = base + offset;
+			head = base + offset + size;
+			return true;
+		}
+
+		static VkDeviceSize lcm(VkDeviceSize a, VkDeviceSize b)
+		{
+			VkDeviceSize x = a;
+			VkDeviceSize y = b;
+			while (y != 0)
+			{
+				VkDeviceSize t = x % y;
+				x = y;
+				y = t;
+			}
+			return a / x * b;
+		}
+
+		VkResult createHostBuffer(VkDeviceSize size, VkBuffer *buffer, vks::Allocation *allocation)
+		{
+			VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo(VK_BUFFER_USAGE_TRANSFER_SRC_BIT, size);
+			VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCreateInfo, nullptr, buffer));
+
+			VkMemoryRequirements memReqs;
+			vkGetBufferMemoryRequirements(device, *buffer, &memReqs);
+
+			const VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+			uint32_t memoryTypeIndex = UINT32_MAX;
+			for (uint32_t i = 0; i < allocator->memoryProperties.memoryTypeCount; i++)
+			{
+				if ((memReqs.memoryTypeBits & (1 << i)) && ((allocator->memoryProperties.memoryTypes[i].propertyFlags & properties) == properties))
+				{
+					memoryTypeIndex = i;
+					break;
+				}
+			}
+			assert(memoryTypeIndex != UINT32_MAX);
+
+			VkResult result = allocator->allocate(memReqs, memoryTypeIndex, vks::AllocationType::Linear, allocation, vks::MemoryCategory::Staging);
+			if (result != VK_SUCCESS)
+			{
+				return result;
+			}
+			return vkBindBufferMemory(device, *buffer, allocation->memory, allocation->offset);
+		}
+	};
+
+	inline bool UploadToken::ready()
+	{
+		return (ring == nullptr) || ring->isComplete(serial);
+	}
+
+	inline void UploadToken::wait()
+	{
+		if (ring)
+		{
+			ring->wait(serial);
+		}
+	}
+
+	inline void UploadToken::acquire(VkCommandBuffer commandBuffer)
+	{
+		if (!ring)
+		{
+			return;
+		}
+		// The release must be submitted before the acquire, the consuming queue waits for it on the gpu
+		ring->claim(serial);
+		if (!bufferBarriers.empty() || !imageBarriers.empty())
+		{
+			// Source stage matches the stage the batch's semaphore is waited at
+			vkCmdPipelineBarrier(
+				commandBuffer,
+				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+				0,
+				0, nullptr,
+				static_cast<uint32_t>(bufferBarriers.size()), bufferBarriers.data(),
+				static_cast<uint32_t>(imageBarriers.size()), imageBarriers.data());
+		}
+		bufferBarriers.clear();
+		imageBarriers.clear();
+		ring = nullptr;
+	}
+}
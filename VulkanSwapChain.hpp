@@ -15,9 +15,14 @@
 #include <assert.h>
 #include <stdio.h>
 #include <vector>
+#include <fstream>
+#include <algorithm>
+#include <functional>
+#include <mutex>
 
 #include <vulkan/vulkan.h>
 #include "VulkanTools.h"
+#include "VulkanMemory.hpp"
 
 #ifdef __ANDROID__
 #include "VulkanAndroid.h"
@@ -65,6 +70,22 @@ private:
 	PFN_vkGetSwapchainImagesKHR fpGetSwapchainImagesKHR;
 	PFN_vkAcquireNextImageKHR fpAcquireNextImageKHR;
 	PFN_vkQueuePresentKHR fpQueuePresentKHR;
+	PFN_vkGetPastPresentationTimingGOOGLE fpGetPastPresentationTimingGOOGLE = nullptr;
+	// Headless mode resources (see initHeadless)
+	VkQueue headlessQueue = VK_NULL_HANDLE;
+	uint32_t headlessIndex = UINT32_MAX;
+	VkExtent2D headlessExtent = {};
+	std::vector<vks::Allocation> headlessMemory;
+	VkCommandPool readbackPool = VK_NULL_HANDLE;
+	std::vector<VkCommandBuffer> readbackCommandBuffers;
+	std::vector<VkBuffer> readbackBuffers;
+	std::vector<vks::Allocation> readbackMemory;
+	std::vector<void*> readbackMapped;
+
+	std::unique_lock<std::mutex> lockQueue()
+	{
+		return queueMutex ? std::unique_lock<std::mutex>(*queueMutex) : std::unique_lock<std::mutex>();
+	}
 public:
 	VkFormat colorFormat;
 	VkColorSpaceKHR colorSpace;
@@ -75,6 +96,34 @@ public:
 	std::vector<SwapChainBuffer> buffers;
 	/** @brief Queue family index of the detected graphics and presenting device queue */
 	uint32_t queueNodeIndex = UINT32_MAX;
+	/** @brief Layout the images have to be in when they are presented, to be used as final layout of render passes */
+	VkImageLayout presentLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
+	/** @brief Present mode to use, VK_PRESENT_MODE_MAX_ENUM_KHR selects one based on the vsync argument of create (falls back to FIFO if unsupported) */
+	VkPresentModeKHR requestedPresentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+	/** @brief Minimum number of images to request, 0 for one more than the surface minimum (clamped to the surface limits) */
+	uint32_t requestedImageCount = 0;
+	/** @brief Present mode selected by the last call to create */
+	VkPresentModeKHR presentMode = VK_PRESENT_MODE_FIFO_KHR;
+	/** @brief Present modes supported by the surface, filled by create */
+	std::vector<VkPresentModeKHR> supportedPresentModes;
+	/** @brief Set to true if VK_GOOGLE_display_timing has been enabled on the device (must be set before connect), presents can then be given an id (see getPastPresentationTimings) */
+	bool displayTiming = false;
+
+	/** @brief Receives the destruction of the previous swapchain (or offscreen images) on re-creation, to run it once the frames in flight no longer use them (destroyed right away if not set) */
+	std::function<void(std::function<void()>)> deferDestruction;
+
+	/** @brief Lock of the presentation queue, held while presenting or submitting to it (set it if other threads submit to the same queue) */
+	std::mutex *queueMutex = nullptr;
+
+	/** @brief Render to offscreen images instead of a surface, no surface or swapchain extensions are used (must be set before connect) */
+	bool headless = false;
+	/** @brief Number of offscreen images rotated through in headless mode */
+	uint32_t headlessImageCount = 3;
+	/** @brief Copy each presented image to host memory in headless mode (see readbackData), must be set before create */
+	bool readback = false;
+	/** @brief Allocator the offscreen images and readback buffers are sub-allocated from in headless mode, must be set before create */
+	vks::MemoryAllocator *memoryAllocator = nullptr;
 
 	/** @brief Creates the platform specific surface abstraction of the native platform window used for presentation */	
 #if defined(VK_USE_PLATFORM_WIN32_KHR)
@@ -260,6 +309,11 @@ public:
 		this->instance = instance;
 		this->physicalDevice = physicalDevice;
 		this->device = device;
+		if (headless)
+		{
+			// The instance has no surface extensions
+			return;
+		}
 		GET_INSTANCE_PROC_ADDR(instance, GetPhysicalDeviceSurfaceSupportKHR);
 		GET_INSTANCE_PROC_ADDR(instance, GetPhysicalDeviceSurfaceCapabilitiesKHR);
 		GET_INSTANCE_PROC_ADDR(instance, GetPhysicalDeviceSurfaceFormatsKHR);
@@ -269,6 +323,11 @@ public:
 		GET_DEVICE_PROC_ADDR(device, GetSwapchainImagesKHR);
 		GET_DEVICE_PROC_ADDR(device, AcquireNextImageKHR);
 		GET_DEVICE_PROC_ADDR(device, QueuePresentKHR);
+		if (displayTiming)
+		{
+			fpGetPastPresentationTimingGOOGLE = reinterpret_cast<PFN_vkGetPastPresentationTimingGOOGLE>(vkGetDeviceProcAddr(device, "vkGetPastPresentationTimingGOOGLE"));
+			displayTiming = (fpGetPastPresentationTimingGOOGLE != nullptr);
+		}
 	}
 
 	/** 
@@ -280,6 +339,12 @@ public:
 	*/
 	void create(uint32_t *width, uint32_t *height, bool vsync = false)
 	{
+		if (headless)
+		{
+			createHeadless(*width, *height);
+			return;
+		}
+
 		VkSwapchainKHR oldSwapchain = swapChain;
 
 		// Get physical device surface properties and formats
@@ -293,6 +358,7 @@ public:
 
 		std::vector<VkPresentModeKHR> presentModes(presentModeCount);
 		VK_CHECK_RESULT(fpGetPhysicalDeviceSurfacePresentModesKHR(physicalDevice, surface, &presentModeCount, presentModes.data()));
+		supportedPresentModes = presentModes;
 
 		VkExtent2D swapchainExtent = {};
 		// If width (and height) equals the special value 0xFFFFFFFF, the size of the surface will be set by the swapchain
@@ -318,9 +384,17 @@ public:
 		// This mode waits for the vertical blank ("v-sync")
 		VkPresentModeKHR swapchainPresentMode = VK_PRESENT_MODE_FIFO_KHR;
 
+		if (requestedPresentMode != VK_PRESENT_MODE_MAX_ENUM_KHR)
+		{
+			// An explicitly requested mode is used if supported
+			if (std::find(presentModes.begin(), presentModes.end(), requestedPresentMode) != presentModes.end())
+			{
+				swapchainPresentMode = requestedPresentMode;
+			}
+		}
 		// If v-sync is not requested, try to find a mailbox mode
 		// It's the lowest latency non-tearing present mode available
-		if (!vsync)
+		else if (!vsync)
 		{
 			for (size_t i = 0; i < presentModeCount; i++)
 			{
@@ -336,8 +410,14 @@ public:
 			}
 		}
 
+		presentMode = swapchainPresentMode;
+
 		// Determine the number of images
 		uint32_t desiredNumberOfSwapchainImages = surfCaps.minImageCount + 1;
+		if (requestedImageCount > 0)
+		{
+			desiredNumberOfSwapchainImages = (requestedImageCount > surfCaps.minImageCount) ? requestedImageCount : surfCaps.minImageCount;
+		}
 		if ((surfCaps.maxImageCount > 0) && (desiredNumberOfSwapchainImages > surfCaps.maxImageCount))
 		{
 			desiredNumberOfSwapchainImages = surfCaps.maxImageCount;
@@ -404,11 +484,29 @@ public:
 		// This also cleans up all the presentable images
 		if (oldSwapchain != VK_NULL_HANDLE) 
 		{ 
+			std::vector<VkImageView> oldViews;
 			for (uint32_t i = 0; i < imageCount; i++)
 			{
-				vkDestroyImageView(device, buffers[i].view, nullptr);
+				oldViews.push_back(buffers[i].view);
+			}
+			VkDevice oldDevice = device;
+			PFN_vkDestroySwapchainKHR destroySwapchain = fpDestroySwapchainKHR;
+			std::function<void()> destroyOld = [oldDevice, oldViews, oldSwapchain, destroySwapchain]()
+			{
+				for (auto view : oldViews)
+				{
+					vkDestroyImageView(oldDevice, view, nullptr);
+				}
+				destroySwapchain(oldDevice, oldSwapchain, nullptr);
+			};
+			if (deferDestruction)
+			{
+				deferDestruction(destroyOld);
+			}
+			else
+			{
+				destroyOld();
 			}
-			fpDestroySwapchainKHR(device, oldSwapchain, nullptr);
 		}
 		VK_CHECK_RESULT(fpGetSwapchainImagesKHR(device, swapChain, &imageCount, NULL));
 
@@ -458,6 +556,22 @@ public:
 	*/
 	VkResult acquireNextImage(VkSemaphore presentCompleteSemaphore, uint32_t *imageIndex)
 	{
+		if (headless)
+		{
+			headlessIndex = (headlessIndex + 1) % imageCount;
+			*imageIndex = headlessIndex;
+			// Offscreen images are available right away, signal the semaphore so frame submissions can wait on it as usual
+			if (presentCompleteSemaphore != VK_NULL_HANDLE)
+			{
+				VkSubmitInfo submitInfo = {};
+				submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+				submitInfo.signalSemaphoreCount = 1;
+				submitInfo.pSignalSemaphores = &presentCompleteSemaphore;
+				std::unique_lock<std::mutex> lock = lockQueue();
+				return vkQueueSubmit(headlessQueue, 1, &submitInfo, VK_NULL_HANDLE);
+			}
+			return VK_SUCCESS;
+		}
 		// By setting timeout to UINT64_MAX we will always wait until the next image has been acquired or an actual error is thrown
 		// With that we don't have to handle VK_NOT_READY
 		return fpAcquireNextImageKHR(device, swapChain, UINT64_MAX, presentCompleteSemaphore, (VkFence)nullptr, imageIndex);
@@ -472,8 +586,33 @@ public:
 	*
 	* @return VkResult of the queue presentation
 	*/
-	VkResult queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore = VK_NULL_HANDLE)
+	VkResult queuePresent(VkQueue queue, uint32_t imageIndex, VkSemaphore waitSemaphore = VK_NULL_HANDLE, uint32_t presentID = 0)
 	{
+		if (headless)
+		{
+			// Consume the semaphore and copy the image to host memory if requested
+			VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+			VkSubmitInfo submitInfo = {};
+			submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			if (waitSemaphore != VK_NULL_HANDLE)
+			{
+				submitInfo.waitSemaphoreCount = 1;
+				submitInfo.pWaitSemaphores = &waitSemaphore;
+				submitInfo.pWaitDstStageMask = &waitStage;
+			}
+			if (readback)
+			{
+				submitInfo.commandBufferCount = 1;
+				submitInfo.pCommandBuffers = &readbackCommandBuffers[imageIndex];
+			}
+			if ((submitInfo.waitSemaphoreCount == 0) && (submitInfo.commandBufferCount == 0))
+			{
+				return VK_SUCCESS;
+			}
+			std::unique_lock<std::mutex> lock = lockQueue();
+			return vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+		}
+
 		VkPresentInfoKHR presentInfo = {};
 		presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
 		presentInfo.pNext = NULL;
@@ -486,15 +625,60 @@ public:
 			presentInfo.pWaitSemaphores = &waitSemaphore;
 			presentInfo.waitSemaphoreCount = 1;
 		}
+		// Tag the present so its actual presentation time can be queried later
+		VkPresentTimeGOOGLE presentTime = { presentID, 0 };
+		VkPresentTimesInfoGOOGLE presentTimesInfo = {};
+		if (displayTiming && (presentID != 0))
+		{
+			presentTimesInfo.sType = VK_STRUCTURE_TYPE_PRESENT_TIMES_INFO_GOOGLE;
+			presentTimesInfo.swapchainCount = 1;
+			presentTimesInfo.pTimes = &presentTime;
+			presentInfo.pNext = &presentTimesInfo;
+		}
+		std::unique_lock<std::mutex> lock = lockQueue();
 		return fpQueuePresentKHR(queue, &presentInfo);
 	}
 
+	/**
+	* Get the presentation times of images presented with an id since the last call
+	*
+	* @param timings Receives the timings, actualPresentTime uses the same clock as std::chrono::steady_clock on Linux and Android
+	*
+	* @return False if display timing is not available (see displayTiming)
+	*/
+	bool getPastPresentationTimings(std::vector<VkPastPresentationTimingGOOGLE> &timings)
+	{
+		timings.clear();
+		if (!displayTiming || headless || (swapChain == VK_NULL_HANDLE))
+		{
+			return false;
+		}
+		uint32_t count = 0;
+		VK_CHECK_RESULT(fpGetPastPresentationTimingGOOGLE(device, swapChain, &count, nullptr));
+		timings.resize(count);
+		if (count > 0)
+		{
+			VkResult result = fpGetPastPresentationTimingGOOGLE(device, swapChain, &count, timings.data());
+			if ((result != VK_SUCCESS) && (result != VK_INCOMPLETE))
+			{
+				VK_CHECK_RESULT(result);
+			}
+			timings.resize(count);
+		}
+		return true;
+	}
+
 
 	/**
 	* Destroy and free Vulkan resources used for the swapchain
 	*/
 	void cleanup()
 	{
+		if (headless)
+		{
+			destroyHeadless();
+			return;
+		}
 		if (swapChain != VK_NULL_HANDLE)
 		{
 			for (uint32_t i = 0; i < imageCount; i++)
@@ -511,6 +695,249 @@ public:
 		swapChain = VK_NULL_HANDLE;
 	}
 
+	/**
+	* Use offscreen images instead of a surface
+	*
+	* @param queue Queue the frames are submitted to, used to signal the acquire semaphores
+	* @param queueFamilyIndex Family of the queue
+	* @param format (Optional) Color format of the images (Defaults to VK_FORMAT_B8G8R8A8_UNORM)
+	*/
+	void initHeadless(VkQueue queue, uint32_t queueFamilyIndex, VkFormat format = VK_FORMAT_B8G8R8A8_UNORM)
+	{
+		headless = true;
+		headlessQueue = queue;
+		queueNodeIndex = queueFamilyIndex;
+		colorFormat = format;
+		colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+		surface = VK_NULL_HANDLE;
+		// Images are only read back by copies after rendering
+		presentLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+	}
+
+	/**
+	* Host copy of an image made when it was last presented in headless mode
+	*
+	* @param imageIndex Index of the image
+	*
+	* @return Tightly packed texels of the image, valid once the frame that presented the image has finished executing (nullptr without readback)
+	*/
+	const void* readbackData(uint32_t imageIndex)
+	{
+		return (readback && (imageIndex < readbackMapped.size())) ? readbackMapped[imageIndex] : nullptr;
+	}
+
+	/**
+	* Write the host copy of an image to a binary PPM file
+	*
+	* @param imageIndex Index of the image
+	* @param filename Name of the file to write
+	*
+	* @return True if the file has been written
+	*/
+	bool saveReadback(uint32_t imageIndex, const std::string &filename)
+	{
+		const uint8_t *data = static_cast<const uint8_t*>(readbackData(imageIndex));
+		if (!data)
+		{
+			return false;
+		}
+		std::ofstream file(filename, std::ios::out | std::ios::binary);
+		if (!file.is_open())
+		{
+			return false;
+		}
+		file << "P6\n" << headlessExtent.width << "\n" << headlessExtent.height << "\n" << 255 << "\n";
+		const bool swizzle = (colorFormat == VK_FORMAT_B8G8R8A8_UNORM) || (colorFormat == VK_FORMAT_B8G8R8A8_SRGB);
+		for (uint32_t i = 0; i < headlessExtent.width * headlessExtent.height; i++)
+		{
+			const uint8_t *texel = data + i * 4;
+			char rgb[3] = { (char)texel[swizzle ? 2 : 0], (char)texel[1], (char)texel[swizzle ? 0 : 2] };
+			file.write(rgb, 3);
+		}
+		return true;
+	}
+
+private:
+	uint32_t headlessMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties)
+	{
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
+		{
+			if ((typeBits & (1 << i)) && ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties))
+			{
+				return i;
+			}
+		}
+		vks::tools::exitFatal("Could not find a memory type for the headless images", "Fatal error");
+		return 0;
+	}
+
+	/** @brief Create the offscreen images (and readback buffers), replaces existing ones */
+	void createHeadless(uint32_t width, uint32_t height)
+	{
+		std::function<void()> destroyOld = takeHeadless();
+		if (deferDestruction)
+		{
+			deferDestruction(destroyOld);
+		}
+		else
+		{
+			destroyOld();
+		}
+
+		assert(memoryAllocator);
+		headlessExtent = { width, height };
+		headlessIndex = UINT32_MAX;
+		imageCount = (requestedImageCount > 0) ? requestedImageCount : headlessImageCount;
+		images.resize(imageCount);
+		buffers.resize(imageCount);
+		headlessMemory.resize(imageCount);
+
+		for (uint32_t i = 0; i < imageCount; i++)
+		{
+			VkImageCreateInfo imageCI = {};
+			imageCI.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+			imageCI.imageType = VK_IMAGE_TYPE_2D;
+			imageCI.format = colorFormat;
+			imageCI.extent = { width, height, 1 };
+			imageCI.mipLevels = 1;
+			imageCI.arrayLayers = 1;
+			imageCI.samples = VK_SAMPLE_COUNT_1_BIT;
+			imageCI.tiling = VK_IMAGE_TILING_OPTIMAL;
+			imageCI.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+			imageCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			imageCI.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+			VK_CHECK_RESULT(vkCreateImage(device, &imageCI, nullptr, &images[i]));
+
+			VkMemoryRequirements memReqs;
+			vkGetImageMemoryRequirements(device, images[i], &memReqs);
+			uint32_t memoryTypeIndex = headlessMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+			VK_CHECK_RESULT(memoryAllocator->allocate(memReqs, memoryTypeIndex, vks::AllocationType::Optimal, &headlessMemory[i], vks::MemoryCategory::Attachment));
+			VK_CHECK_RESULT(vkBindImageMemory(device, images[i], headlessMemory[i].memory, headlessMemory[i].offset));
+
+			VkImageViewCreateInfo colorAttachmentView = {};
+			colorAttachmentView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
+			colorAttachmentView.format = colorFormat;
+			colorAttachmentView.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
+			colorAttachmentView.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+			colorAttachmentView.viewType = VK_IMAGE_VIEW_TYPE_2D;
+			colorAttachmentView.image = images[i];
+			buffers[i].image = images[i];
+			VK_CHECK_RESULT(vkCreateImageView(device, &colorAttachmentView, nullptr, &buffers[i].view));
+		}
+
+		if (!readback)
+		{
+			return;
+		}
+
+		VkCommandPoolCreateInfo cmdPoolInfo = {};
+		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		cmdPoolInfo.queueFamilyIndex = queueNodeIndex;
+		VK_CHECK_RESULT(vkCreateCommandPool(device, &cmdPoolInfo, nullptr, &readbackPool));
+
+		readbackCommandBuffers.resize(imageCount);
+		VkCommandBufferAllocateInfo cmdBufAllocateInfo = {};
+		cmdBufAllocateInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+		cmdBufAllocateInfo.commandPool = readbackPool;
+		cmdBufAllocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		cmdBufAllocateInfo.commandBufferCount = imageCount;
+		VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, readbackCommandBuffers.data()));
+
+		readbackBuffers.resize(imageCount);
+		readbackMemory.resize(imageCount);
+		readbackMapped.resize(imageCount);
+		VkDeviceSize readbackSize = (VkDeviceSize)width * height * 4;
+		for (uint32_t i = 0; i < imageCount; i++)
+		{
+			VkBufferCreateInfo bufferCI = {};
+			bufferCI.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+			bufferCI.size = readbackSize;
+			bufferCI.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+			bufferCI.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+			VK_CHECK_RESULT(vkCreateBuffer(device, &bufferCI, nullptr, &readbackBuffers[i]));
+
+			VkMemoryRequirements memReqs;
+			vkGetBufferMemoryRequirements(device, readbackBuffers[i], &memReqs);
+			uint32_t memoryTypeIndex = headlessMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+			VK_CHECK_RESULT(memoryAllocator->allocate(memReqs, memoryTypeIndex, vks::AllocationType::Linear, &readbackMemory[i], vks::MemoryCategory::Staging));
+			VK_CHECK_RESULT(vkBindBufferMemory(device, readbackBuffers[i], readbackMemory[i].memory, readbackMemory[i].offset));
+			// Host visible blocks are kept mapped by the allocator
+			readbackMapped[i] = readbackMemory[i].mapped;
+
+			// The image is in presentLayout once the frame's render pass has finished
+			VkCommandBufferBeginInfo cmdBufInfo = {};
+			cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			VK_CHECK_RESULT(vkBeginCommandBuffer(readbackCommandBuffers[i], &cmdBufInfo));
+			VkBufferImageCopy copyRegion = {};
+			copyRegion.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			copyRegion.imageExtent = { width, height, 1 };
+			vkCmdCopyImageToBuffer(readbackCommandBuffers[i], images[i], presentLayout, readbackBuffers[i], 1, &copyRegion);
+			VkBufferMemoryBarrier barrier = {};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+			barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+			barrier.buffer = readbackBuffers[i];
+			barrier.size = VK_WHOLE_SIZE;
+			vkCmdPipelineBarrier(readbackCommandBuffers[i], VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+			VK_CHECK_RESULT(vkEndCommandBuffer(readbackCommandBuffers[i]));
+		}
+	}
+
+	/** @brief Take the offscreen images and readback resources out of the swap chain, returns a function destroying them */
+	std::function<void()> takeHeadless()
+	{
+		VkDevice oldDevice = device;
+		vks::MemoryAllocator *oldAllocator = memoryAllocator;
+		std::vector<VkImageView> oldViews;
+		std::vector<VkImage> oldImages;
+		for (uint32_t i = 0; i < headlessMemory.size(); i++)
+		{
+			oldViews.push_back(buffers[i].view);
+			oldImages.push_back(images[i]);
+		}
+		std::vector<vks::Allocation> oldMemory = headlessMemory;
+		std::vector<VkBuffer> oldReadbackBuffers = readbackBuffers;
+		std::vector<vks::Allocation> oldReadbackMemory = readbackMemory;
+		VkCommandPool oldReadbackPool = readbackPool;
+
+		headlessMemory.clear();
+		readbackBuffers.clear();
+		readbackMemory.clear();
+		readbackMapped.clear();
+		readbackPool = VK_NULL_HANDLE;
+		readbackCommandBuffers.clear();
+
+		return [oldDevice, oldAllocator, oldViews, oldImages, oldMemory, oldReadbackBuffers, oldReadbackMemory, oldReadbackPool]() mutable
+		{
+			for (size_t i = 0; i < oldImages.size(); i++)
+			{
+				vkDestroyImageView(oldDevice, oldViews[i], nullptr);
+				vkDestroyImage(oldDevice, oldImages[i], nullptr);
+				oldAllocator->free(oldMemory[i]);
+			}
+			for (size_t i = 0; i < oldReadbackBuffers.size(); i++)
+			{
+				vkDestroyBuffer(oldDevice, oldReadbackBuffers[i], nullptr);
+				oldAllocator->free(oldReadbackMemory[i]);
+			}
+			if (oldReadbackPool != VK_NULL_HANDLE)
+			{
+				vkDestroyCommandPool(oldDevice, oldReadbackPool, nullptr);
+			}
+		};
+	}
+
+	/** @brief Destroy the offscreen images and readback resources */
+	void destroyHeadless()
+	{
+		takeHeadless()();
+	}
+
+public:
 #if defined(_DIRECT2DISPLAY)
 	/**
 	* Create direct to display surface
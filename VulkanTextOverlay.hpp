@@ -15,6 +15,7 @@
 #include <vector>
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
 
 #include <vulkan/vulkan.h>
 #include "VulkanTools.h"
@@ -41,7 +42,8 @@
 
 /**
 * @brief Mostly self-contained text overlay class
-* @note Will only work with compatible render passes
+* @note Drawn inside the application's render pass (see draw), will only work with compatible render passes.
+* drawRenderPass records it into a command buffer of its own instead
 */ 
 class VulkanTextOverlay
 {
@@ -51,6 +53,8 @@ private:
 	VkQueue queue;
 	VkFormat colorFormat;
 	VkFormat depthFormat;
+	// Layout the application's render pass leaves the color attachment in, kept by the overlay's render pass
+	VkImageLayout presentLayout;
 
 	uint32_t *frameBufferWidth;
 	uint32_t *frameBufferHeight;
@@ -58,8 +62,11 @@ private:
 	VkSampler sampler;
 	VkImage image;
 	VkImageView view;
+	// One region of MAX_CHAR_COUNT quads per swap chain image, so an image's text can be updated while other images are in flight
 	vks::Buffer vertexBuffer;
-	VkDeviceMemory imageMemory;
+	// Two triangles per quad, quads past the text are degenerate so the recorded draw never changes
+	vks::Buffer indexBuffer;
+	vks::Allocation imageMemory;
 	VkDescriptorPool descriptorPool;
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkDescriptorSet descriptorSet;
@@ -67,10 +74,13 @@ private:
 	VkPipelineCache pipelineCache;
 	VkPipeline pipeline;
 	VkRenderPass renderPass;
-	VkCommandPool commandPool;
-	std::vector<VkFramebuffer*> frameBuffers;
 	std::vector<VkPipelineShaderStageCreateInfo> shaderStages;
-	VkFence fence;
+
+	uint32_t imageCount;
+	// Text quads written by the last update, copied into the region of an image by prepareImage
+	std::vector<glm::vec4> vertices;
+	std::vector<bool> imageStale;
+	std::vector<bool> imageVisible;
 
 	// Used during text updates
 	glm::vec4 *mappedLocal = nullptr;
@@ -87,12 +97,11 @@ public:
 
 	float scale = 1.0f;
 
-	std::vector<VkCommandBuffer> cmdBuffers;
-
 	/**
 	* Default constructor
 	*
 	* @param vulkanDevice Pointer to a valid VulkanDevice
+	* @param (Optional) presentlayout Final layout of the swap chain images (VulkanSwapChain::presentLayout, transfer source in headless mode)
 	*/
 	VulkanTextOverlay(
 		vks::VulkanDevice *vulkanDevice,
@@ -102,18 +111,16 @@ public:
 		VkFormat depthformat,
 		uint32_t *framebufferwidth,
 		uint32_t *framebufferheight,
-		std::vector<VkPipelineShaderStageCreateInfo> shaderstages)
+		std::vector<VkPipelineShaderStageCreateInfo> shaderstages,
+		VkImageLayout presentlayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR)
 	{
 		this->vulkanDevice = vulkanDevice;
 		this->queue = queue;
 		this->colorFormat = colorformat;
 		this->depthFormat = depthformat;
+		this->presentLayout = presentlayout;
 
-		this->frameBuffers.resize(framebuffers.size());
-		for (uint32_t i = 0; i < framebuffers.size(); i++)
-		{
-			this->frameBuffers[i] = &framebuffers[i];
-		}
+		this->imageCount = static_cast<uint32_t>(framebuffers.size());
 
 		this->shaderStages = shaderstages;
 
@@ -136,7 +143,7 @@ public:
 		};
 #endif
 
-		cmdBuffers.resize(framebuffers.size());
+		vertices.resize(MAX_CHAR_COUNT * 4, glm::vec4(0.0f));
 		prepareResources();
 		prepareRenderPass();
 		preparePipeline();
@@ -149,56 +156,44 @@ public:
 	{
 		// Free up all Vulkan resources requested by the text overlay
 		vertexBuffer.destroy();
+		indexBuffer.destroy();
 		vkDestroySampler(vulkanDevice->logicalDevice, sampler, nullptr);
 		vkDestroyImage(vulkanDevice->logicalDevice, image, nullptr);
 		vkDestroyImageView(vulkanDevice->logicalDevice, view, nullptr);
-		vkFreeMemory(vulkanDevice->logicalDevice, imageMemory, nullptr);
+		vulkanDevice->freeMemory(imageMemory);
 		vkDestroyDescriptorSetLayout(vulkanDevice->logicalDevice, descriptorSetLayout, nullptr);
 		vkDestroyDescriptorPool(vulkanDevice->logicalDevice, descriptorPool, nullptr);
 		vkDestroyPipelineLayout(vulkanDevice->logicalDevice, pipelineLayout, nullptr);
 		vkDestroyPipelineCache(vulkanDevice->logicalDevice, pipelineCache, nullptr);
 		vkDestroyPipeline(vulkanDevice->logicalDevice, pipeline, nullptr);
 		vkDestroyRenderPass(vulkanDevice->logicalDevice, renderPass, nullptr);
-		vkFreeCommandBuffers(vulkanDevice->logicalDevice, commandPool, static_cast<uint32_t>(cmdBuffers.size()), cmdBuffers.data());
-		vkDestroyCommandPool(vulkanDevice->logicalDevice, commandPool, nullptr);
-		vkDestroyFence(vulkanDevice->logicalDevice, fence, nullptr);
 	}
 
 	/**
 	* Prepare all vulkan resources required to render the font
-	* The text overlay uses separate resources for descriptors (pool, sets, layouts), pipelines and command buffers
+	* The text overlay uses separate resources for descriptors (pool, sets, layouts) and pipelines
 	*/
 	void prepareResources()
 	{
 		static unsigned char font24pixels[STB_FONT_HEIGHT][STB_FONT_WIDTH];
 		STB_FONT_NAME(stbFontData, font24pixels, STB_FONT_HEIGHT);
 
-		// Command buffer
-
-		// Pool
-		VkCommandPoolCreateInfo cmdPoolInfo = {};
-		cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-		cmdPoolInfo.queueFamilyIndex = vulkanDevice->queueFamilyIndices.graphics; 
-		cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-		VK_CHECK_RESULT(vkCreateCommandPool(vulkanDevice->logicalDevice, &cmdPoolInfo, nullptr, &commandPool));
-
-		VkCommandBufferAllocateInfo cmdBufAllocateInfo =
-			vks::initializers::commandBufferAllocateInfo(
-				commandPool,
-				VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-				(uint32_t)cmdBuffers.size());
-
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, cmdBuffers.data()));
-
 		// Vertex buffer
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&vertexBuffer,
-			MAX_CHAR_COUNT * sizeof(glm::vec4)));
+		prepareVertexBuffer();
 
-		// Map persistent
-		vertexBuffer.map();
+		// Index buffer
+		std::vector<uint16_t> indices(MAX_CHAR_COUNT * 6);
+		for (uint16_t i = 0; i < MAX_CHAR_COUNT; i++)
+		{
+			// Same triangles as a four vertex strip
+			const uint16_t indexBase = i * 4;
+			const uint16_t quad[6] = { 0, 1, 2, 2, 1, 3 };
+			for (uint32_t j = 0; j < 6; j++)
+			{
+				indices[i * 6 + j] = indexBase + quad[j];
+			}
+		}
+		VK_CHECK_RESULT(vulkanDevice->createDeviceLocalBuffer(VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &indexBuffer, indices.size() * sizeof(uint16_t), indices.data()));
 
 		// Font texture
 		VkImageCreateInfo imageInfo = vks::initializers::imageCreateInfo();
@@ -216,34 +211,13 @@ public:
 		imageInfo.initialLayout = VK_IMAGE_LAYOUT_PREINITIALIZED;
 		VK_CHECK_RESULT(vkCreateImage(vulkanDevice->logicalDevice, &imageInfo, nullptr, &image));
 
-		VkMemoryRequirements memReqs;
-		VkMemoryAllocateInfo allocInfo = vks::initializers::memoryAllocateInfo();
-		vkGetImageMemoryRequirements(vulkanDevice->logicalDevice, image, &memReqs);
-		allocInfo.allocationSize = memReqs.size;
-		allocInfo.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-		VK_CHECK_RESULT(vkAllocateMemory(vulkanDevice->logicalDevice, &allocInfo, nullptr, &imageMemory));
-		VK_CHECK_RESULT(vkBindImageMemory(vulkanDevice->logicalDevice, image, imageMemory, 0));
+		VK_CHECK_RESULT(vulkanDevice->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &imageMemory));
 
-		// Staging
-		vks::Buffer stagingBuffer;
-
-		VK_CHECK_RESULT(vulkanDevice->createBuffer(
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-			&stagingBuffer,
-			allocInfo.allocationSize));
-
-		stagingBuffer.map();
-		memcpy(stagingBuffer.mapped, &font24pixels[0][0], STB_FONT_WIDTH * STB_FONT_HEIGHT);	// Only one channel, so data size = W * H (*R8)
-		stagingBuffer.unmap();
-
-		// Copy to image
-		VkCommandBuffer copyCmd;
-		cmdBufAllocateInfo.commandBufferCount = 1;
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, &copyCmd));
-
-		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-		VK_CHECK_RESULT(vkBeginCommandBuffer(copyCmd, &cmdBufInfo));
+		// Upload the font through the staging ring, submitted with the ring's next batch
+		// Only one channel, so data size = W * H (*R8)
+		vks::StagingRing *staging = vulkanDevice->getStagingRing();
+		vks::StagingRegion stagingRegion = staging->stage(&font24pixels[0][0], STB_FONT_WIDTH * STB_FONT_HEIGHT, staging->imageCopyAlignment(1));
+		VkCommandBuffer copyCmd = staging->commandBuffer();
 
 		// Prepare for transfer
 		vks::tools::setImageLayout(
@@ -260,10 +234,11 @@ public:
 		bufferCopyRegion.imageExtent.width = STB_FONT_WIDTH;
 		bufferCopyRegion.imageExtent.height = STB_FONT_HEIGHT;
 		bufferCopyRegion.imageExtent.depth = 1;
+		bufferCopyRegion.bufferOffset = stagingRegion.offset;
 
 		vkCmdCopyBufferToImage(
 			copyCmd,
-			stagingBuffer.buffer,
+			stagingRegion.buffer,
 			image,
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			1,
@@ -278,19 +253,6 @@ public:
 			VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
 			VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 
-		VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
-
-		VkSubmitInfo submitInfo = vks::initializers::submitInfo();
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &copyCmd;
-
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-		VK_CHECK_RESULT(vkQueueWaitIdle(queue));
-
-		stagingBuffer.destroy();
-
-		vkFreeCommandBuffers(vulkanDevice->logicalDevice, commandPool, 1, &copyCmd);
-
 		VkImageViewCreateInfo imageViewInfo = vks::initializers::imageViewCreateInfo();
 		imageViewInfo.image = image;
 		imageViewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -370,10 +332,31 @@ public:
 		VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
 		pipelineCacheCreateInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
 		VK_CHECK_RESULT(vkCreatePipelineCache(vulkanDevice->logicalDevice, &pipelineCacheCreateInfo, nullptr, &pipelineCache));
+	}
 
-		// Command buffer execution fence
-		VkFenceCreateInfo fenceCreateInfo = vks::initializers::fenceCreateInfo();
-		VK_CHECK_RESULT(vkCreateFence(vulkanDevice->logicalDevice, &fenceCreateInfo, nullptr, &fence));
+	/**
+	* Create the persistently mapped vertex buffer with one region per swap chain image
+	*/
+	void prepareVertexBuffer()
+	{
+		VK_CHECK_RESULT(vulkanDevice->createBuffer(
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			&vertexBuffer,
+			imageCount * regionSize()));
+
+		// Map persistent
+		vertexBuffer.map();
+		memset(vertexBuffer.mapped, 0, imageCount * regionSize());
+
+		imageStale.assign(imageCount, true);
+		imageVisible.assign(imageCount, false);
+	}
+
+	/** @brief Size of the vertex data of one swap chain image */
+	VkDeviceSize regionSize()
+	{
+		return MAX_CHAR_COUNT * 4 * sizeof(glm::vec4);
 	}
 
 	/**
@@ -383,7 +366,7 @@ public:
 	{
 		VkPipelineInputAssemblyStateCreateInfo inputAssemblyState =
 			vks::initializers::pipelineInputAssemblyStateCreateInfo(
-				VK_PRIMITIVE_TOPOLOGY_TRIANGLE_STRIP,
+				VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST,
 				0,
 				VK_FALSE);
 
@@ -473,7 +456,7 @@ public:
 	}
 
 	/**
-	* Prepare a separate render pass for rendering the text as an overlay
+	* Prepare the render pass used by drawRenderPass, also compatible with the application's render pass the overlay can be drawn in
 	*/
 	void prepareRenderPass()
 	{
@@ -487,8 +470,9 @@ public:
 		attachments[0].storeOp = VK_ATTACHMENT_STORE_OP_STORE;
 		attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 		attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
-		attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-		attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+		// The contents are loaded, so the image comes in the layout the application's render pass left it in
+		attachments[0].initialLayout = presentLayout;
+		attachments[0].finalLayout = presentLayout;
 
 		// Depth attachment
 		attachments[1].format = depthFormat;
@@ -511,11 +495,12 @@ public:
 		VkSubpassDependency subpassDependencies[2] = {};
 
 		// Transition from final to initial (VK_SUBPASS_EXTERNAL refers to all commmands executed outside of the actual renderpass)
+		// The application's pass writing the image is submitted in the same batch, its color writes have to be visible to the overlay
 		subpassDependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL;
 		subpassDependencies[0].dstSubpass = 0;
-		subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT;
+		subpassDependencies[0].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 		subpassDependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		subpassDependencies[0].srcAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+		subpassDependencies[0].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 		subpassDependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
 		subpassDependencies[0].dependencyFlags = VK_DEPENDENCY_BY_REGION_BIT;
 
@@ -554,11 +539,11 @@ public:
 	}
 
 	/**
-	* Maps the buffer, resets letter count
+	* Resets letter count, text is written to a host copy until endTextUpdate
 	*/
 	void beginTextUpdate()
 	{
-		mappedLocal = (glm::vec4*)vertexBuffer.mapped;
+		mappedLocal = vertices.data();
 		numLetters = 0;
 	}
 
@@ -572,7 +557,7 @@ public:
 	*/
 	void addText(std::string text, float x, float y, TextAlign align)
 	{
-		assert(vertexBuffer.mapped != nullptr);
+		assert(mappedLocal != nullptr);
 
 		if (align == alignLeft) {
 			x *= scale;
@@ -611,6 +596,11 @@ public:
 		// Generate a uv mapped quad per char in the new text
 		for (auto letter : text)
 		{
+			if (numLetters >= MAX_CHAR_COUNT)
+			{
+				break;
+			}
+
 			stb_fontchar *charData = &stbFontData[(uint32_t)letter - STB_FIRST_CHAR];
 
 			mappedLocal->x = (x + (float)charData->x0 * charW);
@@ -644,103 +634,128 @@ public:
 	}
 
 	/**
-	* Unmap buffer and update command buffers
+	* Finish the text update, each image picks up the new text in prepareImage
 	*/
 	void endTextUpdate()
 	{
-		updateCommandBuffers();
+		// Collapse the unused quads so they don't produce any fragments
+		std::fill(vertices.begin() + numLetters * 4, vertices.end(), glm::vec4(0.0f));
+		mappedLocal = nullptr;
+		imageStale.assign(imageCount, true);
 	}
 
 	/**
-	* Update the command buffers to reflect text changes
+	* Copy the current text into the vertex region of a swap chain image
+	*
+	* @param imageIndex Index of the swap chain image about to be rendered
+	*
+	* @note The image's previous frame must have finished executing, no other synchronization is done
 	*/
-	void updateCommandBuffers()
+	void prepareImage(uint32_t imageIndex)
 	{
-		VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
-
-		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
-		renderPassBeginInfo.renderPass = renderPass;
-		renderPassBeginInfo.renderArea.extent.width = *frameBufferWidth;
-		renderPassBeginInfo.renderArea.extent.height = *frameBufferHeight;
-		// None of the attachments will be cleared
-		renderPassBeginInfo.clearValueCount = 0;
-		renderPassBeginInfo.pClearValues = nullptr;
-
-		for (size_t i = 0; i < cmdBuffers.size(); ++i)
+		if ((imageIndex >= imageCount) || (!imageStale[imageIndex] && (imageVisible[imageIndex] == visible)))
 		{
-			renderPassBeginInfo.framebuffer = *frameBuffers[i];
+			return;
+		}
 
-			VK_CHECK_RESULT(vkBeginCommandBuffer(cmdBuffers[i], &cmdBufInfo));
+		uint8_t *region = static_cast<uint8_t*>(vertexBuffer.mapped) + imageIndex * regionSize();
+		if (visible)
+		{
+			memcpy(region, vertices.data(), regionSize());
+		}
+		else
+		{
+			memset(region, 0, regionSize());
+		}
+		imageStale[imageIndex] = false;
+		imageVisible[imageIndex] = visible;
+	}
 
-			if (vks::debugmarker::active)
-			{
-				vks::debugmarker::beginRegion(cmdBuffers[i], "Text overlay", glm::vec4(1.0f, 0.94f, 0.3f, 1.0f));
-			}
+	/**
+	* Record the text overlay into a command buffer
+	*
+	* @param commandBuffer Command buffer inside a render pass compatible with the overlay's (same color and depth formats, single sample)
+	* @param imageIndex Index of the swap chain image the command buffer renders to
+	*
+	* @note Only needs to be recorded once, text changes and visibility are applied by prepareImage
+	*/
+	void draw(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+	{
+		assert(imageIndex < imageCount);
 
-			vkCmdBeginRenderPass(cmdBuffers[i], &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		if (vks::debugmarker::active)
+		{
+			vks::debugmarker::beginRegion(commandBuffer, "Text overlay", glm::vec4(1.0f, 0.94f, 0.3f, 1.0f));
+		}
+		if (vulkanDevice->profiler)
+		{
+			vulkanDevice->profiler->beginScope(commandBuffer, imageIndex, "Text overlay");
+		}
 
-			VkViewport viewport = vks::initializers::viewport((float)*frameBufferWidth, (float)*frameBufferHeight, 0.0f, 1.0f);
-			vkCmdSetViewport(cmdBuffers[i], 0, 1, &viewport);
+		VkViewport viewport = vks::initializers::viewport((float)*frameBufferWidth, (float)*frameBufferHeight, 0.0f, 1.0f);
+		vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
 
-			VkRect2D scissor = vks::initializers::rect2D(*frameBufferWidth, *frameBufferHeight, 0, 0);
-			vkCmdSetScissor(cmdBuffers[i], 0, 1, &scissor);
-			
-			vkCmdBindPipeline(cmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-			vkCmdBindDescriptorSets(cmdBuffers[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
+		VkRect2D scissor = vks::initializers::rect2D(*frameBufferWidth, *frameBufferHeight, 0, 0);
+		vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
 
-			VkDeviceSize offsets = 0;
-			vkCmdBindVertexBuffers(cmdBuffers[i], 0, 1, &vertexBuffer.buffer, &offsets);
-			vkCmdBindVertexBuffers(cmdBuffers[i], 1, 1, &vertexBuffer.buffer, &offsets);
-			for (uint32_t j = 0; j < numLetters; j++)
-			{
-				vkCmdDraw(cmdBuffers[i], 4, 1, j * 4, 0);
-			}
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSet, 0, NULL);
 
-			vkCmdEndRenderPass(cmdBuffers[i]);
+		VkDeviceSize offsets = imageIndex * regionSize();
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer.buffer, &offsets);
+		vkCmdBindVertexBuffers(commandBuffer, 1, 1, &vertexBuffer.buffer, &offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer.buffer, 0, VK_INDEX_TYPE_UINT16);
+		vkCmdDrawIndexed(commandBuffer, MAX_CHAR_COUNT * 6, 1, 0, 0, 0);
 
-			if (vks::debugmarker::active)
-			{
-				vks::debugmarker::endRegion(cmdBuffers[i]);
-			}
-
-			VK_CHECK_RESULT(vkEndCommandBuffer(cmdBuffers[i]));
+		if (vulkanDevice->profiler)
+		{
+			vulkanDevice->profiler->endScope(commandBuffer, imageIndex, "Text overlay");
+		}
+		if (vks::debugmarker::active)
+		{
+			vks::debugmarker::endRegion(commandBuffer);
 		}
 	}
 
 	/**
-	* Submit the text command buffers to a queue
+	* Record the text overlay in its own render pass, loading the contents of the frame buffer
+	*
+	* @param commandBuffer Command buffer outside of a render pass
+	* @param frameBuffer Frame buffer of the swap chain image, with color and depth attachments matching the overlay's formats
+	* @param imageIndex Index of the swap chain image the command buffer renders to
 	*/
-	void submit(VkQueue queue, uint32_t bufferindex, VkSubmitInfo submitInfo)
+	void drawRenderPass(VkCommandBuffer commandBuffer, VkFramebuffer frameBuffer, uint32_t imageIndex)
 	{
-		if (!visible)
-		{
-			return;
-		}
-
-		submitInfo.pCommandBuffers = &cmdBuffers[bufferindex];
-		submitInfo.commandBufferCount = 1;
-
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+		VkRenderPassBeginInfo renderPassBeginInfo = vks::initializers::renderPassBeginInfo();
+		renderPassBeginInfo.renderPass = renderPass;
+		renderPassBeginInfo.renderArea.extent.width = *frameBufferWidth;
+		renderPassBeginInfo.renderArea.extent.height = *frameBufferHeight;
+		renderPassBeginInfo.clearValueCount = 0;
+		renderPassBeginInfo.pClearValues = nullptr;
+		renderPassBeginInfo.framebuffer = frameBuffer;
 
-		VK_CHECK_RESULT(vkWaitForFences(vulkanDevice->logicalDevice, 1, &fence, VK_TRUE, UINT64_MAX));
-		VK_CHECK_RESULT(vkResetFences(vulkanDevice->logicalDevice, 1, &fence));
+		vkCmdBeginRenderPass(commandBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+		draw(commandBuffer, imageIndex);
+		vkCmdEndRenderPass(commandBuffer);
 	}
 
 	/**
-	* Reallocate command buffers for the text overlay
-	* @note Frees the existing command buffers
+	* Resize the vertex buffer for a new swap chain image count
+	*
+	* @note The previous vertex buffer is retired to the device, so frames in flight may still draw from it
 	*/
-	void reallocateCommandBuffers()
+	void resize(uint32_t newImageCount)
 	{
-		vkFreeCommandBuffers(vulkanDevice->logicalDevice, commandPool, static_cast<uint32_t>(cmdBuffers.size()), cmdBuffers.data());
-
-		VkCommandBufferAllocateInfo cmdBufAllocateInfo =
-			vks::initializers::commandBufferAllocateInfo(
-				commandPool,
-				VK_COMMAND_BUFFER_LEVEL_PRIMARY,
-				static_cast<uint32_t>(cmdBuffers.size()));
-
-		VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice->logicalDevice, &cmdBufAllocateInfo, cmdBuffers.data()));
+		if (newImageCount != imageCount)
+		{
+			vulkanDevice->retireBuffer(vertexBuffer);
+			imageCount = newImageCount;
+			prepareVertexBuffer();
+		}
+		else
+		{
+			imageStale.assign(imageCount, true);
+		}
 	}
 
 };
@@ -12,6 +12,10 @@
 #include <string>
 #include <fstream>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
 
 #include "vulkan/vulkan.h"
 
@@ -20,6 +24,9 @@
 #include "VulkanTools.h"
 #include "VulkanDevice.hpp"
 #include "VulkanBuffer.hpp"
+#include "threadpool.hpp"
+#include "resample.hpp"
+#include "trace.hpp"
 
 
 #if defined(__ANDROID__)
@@ -34,11 +41,13 @@ namespace vks
     /** @brief Vulkan texture base class */
     class Texture {
     public:
-        vks::VulkanDevice *device;
-        VkImage image;
+        vks::VulkanDevice *device = nullptr;
+        VkImage image = VK_NULL_HANDLE;
         VkImageLayout imageLayout;
-        VkDeviceMemory deviceMemory;
-        VkImageView view;
+        VkDeviceMemory deviceMemory = VK_NULL_HANDLE;
+        /** @brief Sub-range of a device memory block backing the image (deviceMemory is the block's handle) */
+        vks::Allocation allocation;
+        VkImageView view = VK_NULL_HANDLE;
         VkFormat format;
         uint32_t width, height;
         uint32_t mipLevels;
@@ -46,7 +55,7 @@ namespace vks
         VkDescriptorImageInfo descriptor;
 
         /** @brief Optional sampler to use with this texture */
-        VkSampler sampler;
+        VkSampler sampler = VK_NULL_HANDLE;
 
         /** @brief Update image descriptor from current sampler, view and image layout */
         void updateDescriptor()
@@ -59,46 +68,124 @@ namespace vks
         /** @brief Release all Vulkan resources held by this texture */
         void destroy()
         {
-            if (image == nullptr)
+            if (image == VK_NULL_HANDLE)
                 return;
-            vkDestroyImageView(device->logicalDevice, view, nullptr);
+            if (view)
+            {
+                vkDestroyImageView(device->logicalDevice, view, nullptr);
+            }
             vkDestroyImage(device->logicalDevice, image, nullptr);
             if (sampler)
             {
                 vkDestroySampler(device->logicalDevice, sampler, nullptr);
             }
-            vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+            if (allocation.block)
+            {
+                device->freeMemory(allocation);
+            }
+            else
+            {
+                vkFreeMemory(device->logicalDevice, deviceMemory, nullptr);
+            }
+            image = VK_NULL_HANDLE;
+            view = VK_NULL_HANDLE;
+            sampler = VK_NULL_HANDLE;
+            deviceMemory = VK_NULL_HANDLE;
         }
 
-        void loadStbLinearNoSampling (
-            std::string filename,
-            vks::VulkanDevice *device,
-            VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
-            bool flipY = true)
+        /**
+        * Hand all Vulkan resources held by this texture over to the device, they are destroyed once the frame being recorded has finished executing
+        *
+        * @note Use instead of destroy for textures that submitted frames may still sample
+        */
+        void retire()
         {
-            this->device = device;
+            if (image == VK_NULL_HANDLE)
+                return;
+            device->retireImageView(view);
+            device->retireImage(image);
+            device->retireSampler(sampler);
+            if (allocation.block)
+            {
+                device->retireAllocation(allocation);
+            }
+            else
+            {
+                device->retireMemory(deviceMemory);
+            }
+            image = VK_NULL_HANDLE;
+            view = VK_NULL_HANDLE;
+            sampler = VK_NULL_HANDLE;
+            deviceMemory = VK_NULL_HANDLE;
+        }
 
-            stbi_set_flip_vertically_on_load(flipY);
+        /** @brief Pixels of an image file decoded by decodeStb */
+        struct ImageData {
+            unsigned char *pixels = nullptr;
+            uint32_t width = 0;
+            uint32_t height = 0;
+            uint32_t channels = 0;
+            /** @brief Reason the file could not be decoded, empty on success */
+            std::string error;
+        };
+
+        /**
+        * Decode an image file with stb_image on the cpu only, files can be decoded from several threads at once
+        *
+        * @param filename File to decode, looked up in the "datas" folder if not found
+        * @param (Optional) desiredChannels Number of channels to convert the pixels to, 0 to keep the file's channels
+        *
+        * @return Decoded pixels to be released with stbi_image_free (by createLinearFromData), or the error
+        *
+        * @note The vertical flip is a global stb_image setting, set it with stbi_set_flip_vertically_on_load before decoding.
+        * The failure reason is a global of the vendored stb_image too, when decodes fail on several threads at once the error may name another file's reason
+        */
+        static ImageData decodeStb(std::string filename, int desiredChannels = 0)
+        {
+            VKS_TRACE_ZONE("Image decode");
+            ImageData data;
             if (!vks::tools::fileExists(filename)) {
                 filename = "datas/" + filename;
                 if (!vks::tools::fileExists(filename)){
                     std::replace( filename.begin(), filename.end(), '\\', '/');
-                    if (!vks::tools::fileExists(filename))
-                        vks::tools::exitFatal("Could not load texture from " + filename, "File not found");
+                    if (!vks::tools::fileExists(filename)) {
+                        data.error = "Could not load texture from " + filename + ", File not found";
+                        return data;
+                    }
                 }
             }
 
             int w=0,h=0,channels=0;
-            unsigned char *img = stbi_load(filename.c_str(),&w,&h,&channels,0);
-            if (img == NULL)
-                vks::tools::exitFatal("Could not load texture from " + filename, ", error: " + std::string(stbi_failure_reason()));
+            data.pixels = stbi_load(filename.c_str(),&w,&h,&channels,desiredChannels);
+            if (data.pixels == NULL) {
+                data.error = "Could not load texture from " + filename + ", error: " + std::string(stbi_failure_reason());
+                return data;
+            }
+            data.width = static_cast<uint32_t>(w);
+            data.height = static_cast<uint32_t>(h);
+            data.channels = static_cast<uint32_t>((desiredChannels > 0) ? desiredChannels : channels);
+            return data;
+        }
 
-            width = static_cast<uint32_t>(w);
-            height = static_cast<uint32_t>(h);
+        /**
+        * Create a linear tiled, host visible image from decoded pixels
+        *
+        * @param data Decoded pixels, released by the call
+        * @param device Vulkan device to create the image on
+        * @param (Optional) imageUsageFlags Usage flags for the image (defaults to VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+        */
+        void createLinearFromData(
+            ImageData &data,
+            vks::VulkanDevice *device,
+            VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_TRANSFER_SRC_BIT)
+        {
+            this->device = device;
+            width = data.width;
+            height = data.height;
             mipLevels = 1;
-            uint32_t imgSize = width * height * channels;
+            uint32_t imgSize = width * height * data.channels;
 
-            switch (channels) {
+            switch (data.channels) {
             case 1:
                 format = VK_FORMAT_R8_UNORM;
                 break;
@@ -127,27 +214,32 @@ namespace vks
             imageCreateInfo.extent = { width, height, 1 };
             VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-            VkMemoryRequirements memReqs = {};
-            VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-            vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-            memAllocInfo.allocationSize = memReqs.size;
-            memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits,
-                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-            VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));	// Allocate host memory
-            VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));		// Bind allocated image for use
+            // Host visible memory blocks are persistently mapped by the allocator
+            VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &allocation, VK_IMAGE_TILING_LINEAR, vks::MemoryCategory::Staging));
+            deviceMemory = allocation.memory;
 
             VkImageSubresource subRes = {};
             subRes.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
             VkSubresourceLayout subResLayout;
-            void *data;
             vkGetImageSubresourceLayout(device->logicalDevice, image, &subRes, &subResLayout);
-            VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, deviceMemory, 0, memReqs.size, 0, &data));
-            memcpy(data, img, imgSize);	// Copy image data into memory
-            vkUnmapMemory(device->logicalDevice, deviceMemory);
-
-            stbi_image_free(img);
+            memcpy(allocation.mapped, data.pixels, imgSize);	// Copy image data into memory
 
+            stbi_image_free(data.pixels);
+            data.pixels = nullptr;
+        }
 
+        void loadStbLinearNoSampling (
+            std::string filename,
+            vks::VulkanDevice *device,
+            VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+            bool flipY = true)
+        {
+            VKS_TRACE_ZONE("Texture load");
+            stbi_set_flip_vertically_on_load(flipY);
+            ImageData data = decodeStb(filename);
+            if (data.pixels == NULL)
+                vks::tools::exitFatal(data.error, "Image decode failed");
+            createLinearFromData(data, device, imageUsageFlags);
         }
     };
 
@@ -160,7 +252,7 @@ namespace vks
         * @param filename File to load (supports .ktx and .dds)
         * @param format Vulkan format of the image data stored in the file
         * @param device Vulkan device to create the texture on
-        * @param copyQueue Queue used for the texture staging copy commands (must support transfer)
+        * @param copyQueue Queue used for the layout transition of linear tiled images, staged copies are recorded into the device's staging ring
         * @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
         * @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
         * @param (Optional) forceLinear Force linear tiling (not advised, defaults to false)
@@ -174,6 +266,7 @@ namespace vks
             VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
             bool forceLinear = false)
         {
+            VKS_TRACE_ZONE("Texture load");
 #if defined(__ANDROID__)
             // Textures are stored inside the apk on Android (compressed)
             // So they need to be loaded via the asset manager
@@ -214,45 +307,16 @@ namespace vks
             // limited amount of formats and features (mip maps, cubemaps, arrays, etc.)
             VkBool32 useStaging = !forceLinear;
 
-            VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-            VkMemoryRequirements memReqs;
-
-            // Use a separate command buffer for texture loading
-            VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
             if (useStaging)
             {
-                // Create a host-visible staging buffer that contains the raw image data
-                VkBuffer stagingBuffer;
-                VkDeviceMemory stagingMemory;
-
-                VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-                bufferCreateInfo.size = tex2D.size();
-                // This buffer is used as a transfer source for the buffer copy
-                bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-                bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-                VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-                // Get memory requirements for the staging buffer (alignment, memory type bits)
-                vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-
-                memAllocInfo.allocationSize = memReqs.size;
-                // Get memory type index for a host visible buffer
-                memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-                VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-                VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-                // Copy texture data into staging buffer
-                uint8_t *data;
-                VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-                memcpy(data, tex2D.data(), tex2D.size());
-                vkUnmapMemory(device->logicalDevice, stagingMemory);
+                // Copy the raw image data into the shared staging ring, the copy is recorded into the ring's current batch
+                vks::StagingRing *staging = device->getStagingRing();
+                vks::StagingRegion stagingRegion = staging->stage(tex2D.data(), tex2D.size(), staging->imageCopyAlignment(gli::block_size(tex2D.format())));
+                VkCommandBuffer copyCmd = staging->commandBuffer();
 
                 // Setup buffer copy regions for each mip level
                 std::vector<VkBufferImageCopy> bufferCopyRegions;
-                uint32_t offset = 0;
+                VkDeviceSize offset = stagingRegion.offset;
 
                 for (uint32_t i = 0; i < mipLevels; i++)
                 {
@@ -290,13 +354,8 @@ namespace vks
                 }
                 VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-                vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-                memAllocInfo.allocationSize = memReqs.size;
-
-                memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-                VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-                VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+                VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation));
+                deviceMemory = allocation.memory;
 
                 VkImageSubresourceRange subresourceRange = {};
                 subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -316,7 +375,7 @@ namespace vks
                 // Copy mip levels from staging buffer
                 vkCmdCopyBufferToImage(
                     copyCmd,
-                    stagingBuffer,
+                    stagingRegion.buffer,
                     image,
                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                     static_cast<uint32_t>(bufferCopyRegions.size()),
@@ -331,12 +390,6 @@ namespace vks
                     VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                     imageLayout,
                     subresourceRange);
-
-                device->flushCommandBuffer(copyCmd, copyQueue);
-
-                // Clean up staging resources
-                vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-                vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
             }
             else
             {
@@ -348,7 +401,6 @@ namespace vks
                 assert(formatProperties.linearTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT);
 
                 VkImage mappableImage;
-                VkDeviceMemory mappableMemory;
 
                 VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
                 imageCreateInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -365,20 +417,8 @@ namespace vks
                 // Load mip map level 0 to linear tiling image
                 VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &mappableImage));
 
-                // Get memory requirements for this image
-                // like size and alignment
-                vkGetImageMemoryRequirements(device->logicalDevice, mappableImage, &memReqs);
-                // Set memory allocation size to required memory size
-                memAllocInfo.allocationSize = memReqs.size;
-
-                // Get memory type that can be mapped to host memory
-                memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-                // Allocate host memory
-                VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &mappableMemory));
-
-                // Bind allocated image for use
-                VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, mappableImage, mappableMemory, 0));
+                // Allocate and bind host visible memory (persistently mapped by the allocator)
+                VK_CHECK_RESULT(device->allocateImageMemory(mappableImage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, &allocation, VK_IMAGE_TILING_LINEAR));
 
                 // Get sub resource layout
                 // Mip map count, array layer, etc.
@@ -387,27 +427,22 @@ namespace vks
                 subRes.mipLevel = 0;
 
                 VkSubresourceLayout subResLayout;
-                void *data;
 
                 // Get sub resources layout
                 // Includes row pitch, size offsets, etc.
                 vkGetImageSubresourceLayout(device->logicalDevice, mappableImage, &subRes, &subResLayout);
 
-                // Map image memory
-                VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, mappableMemory, 0, memReqs.size, 0, &data));
-
                 // Copy image data into memory
-                memcpy(data, tex2D[subRes.mipLevel].data(), tex2D[subRes.mipLevel].size());
-
-                vkUnmapMemory(device->logicalDevice, mappableMemory);
+                memcpy(allocation.mapped, tex2D[subRes.mipLevel].data(), tex2D[subRes.mipLevel].size());
 
                 // Linear tiled images don't need to be staged
                 // and can be directly used as textures
                 image = mappableImage;
-                deviceMemory = mappableMemory;
+                deviceMemory = allocation.memory;
                 this->imageLayout = imageLayout;
 
                 // Setup image memory barrier
+                VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
                 vks::tools::setImageLayout(copyCmd, image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_UNDEFINED, imageLayout);
 
                 device->flushCommandBuffer(copyCmd, copyQueue);
@@ -462,7 +497,7 @@ namespace vks
         * @param height Height of the texture to create
         * @param format Vulkan format of the image data stored in the file
         * @param device Vulkan device to create the texture on
-        * @param copyQueue Queue used for the texture staging copy commands (must support transfer)
+        * @param copyQueue Unused, the copy commands are recorded into the device's staging ring and submitted with its next batch
         * @param (Optional) filter Texture filtering for the sampler (defaults to VK_FILTER_LINEAR)
         * @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
         * @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
@@ -486,39 +521,10 @@ namespace vks
             this->height = height;
             mipLevels = 1;
 
-            VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-            VkMemoryRequirements memReqs;
-
-            // Use a separate command buffer for texture loading
-            VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-
-            // Create a host-visible staging buffer that contains the raw image data
-            VkBuffer stagingBuffer;
-            VkDeviceMemory stagingMemory;
-
-            VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-            bufferCreateInfo.size = bufferSize;
-            // This buffer is used as a transfer source for the buffer copy
-            bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-            VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-            // Get memory requirements for the staging buffer (alignment, memory type bits)
-            vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-
-            memAllocInfo.allocationSize = memReqs.size;
-            // Get memory type index for a host visible buffer
-            memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-            VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-            VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-            // Copy texture data into staging buffer
-            uint8_t *data;
-            VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-            memcpy(data, buffer, bufferSize);
-            vkUnmapMemory(device->logicalDevice, stagingMemory);
+            // Copy the raw image data into the shared staging ring, the copy is recorded into the ring's current batch
+            vks::StagingRing *staging = device->getStagingRing();
+            vks::StagingRegion stagingRegion = staging->stage(buffer, bufferSize, staging->imageCopyAlignment(gli::block_size(static_cast<gli::format>(format))));
+            VkCommandBuffer copyCmd = staging->commandBuffer();
 
             VkBufferImageCopy bufferCopyRegion = {};
             bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -528,7 +534,7 @@ namespace vks
             bufferCopyRegion.imageExtent.width = width;
             bufferCopyRegion.imageExtent.height = height;
             bufferCopyRegion.imageExtent.depth = 1;
-            bufferCopyRegion.bufferOffset = 0;
+            bufferCopyRegion.bufferOffset = stagingRegion.offset;
 
             // Create optimal tiled target image
             VkImageCreateInfo imageCreateInfo = vks::initializers::imageCreateInfo();
@@ -549,13 +555,8 @@ namespace vks
             }
             VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-            vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-            memAllocInfo.allocationSize = memReqs.size;
-
-            memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-            VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-            VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
+            VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation));
+            deviceMemory = allocation.memory;
 
             VkImageSubresourceRange subresourceRange = {};
             subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
@@ -575,7 +576,7 @@ namespace vks
             // Copy mip levels from staging buffer
             vkCmdCopyBufferToImage(
                 copyCmd,
-                stagingBuffer,
+                stagingRegion.buffer,
                 image,
                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                 1,
@@ -591,12 +592,6 @@ namespace vks
                 imageLayout,
                 subresourceRange);
 
-            device->flushCommandBuffer(copyCmd, copyQueue);
-
-            // Clean up staging resources
-            vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-            vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
             // Create sampler
             VkSamplerCreateInfo samplerCreateInfo = {};
             samplerCreateInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -634,17 +629,41 @@ namespace vks
     /** @brief 2D array texture */
     class Texture2DArray : public Texture {
     public:
+        /**
+        * Build a texture array with a full mip chain from image files, each file is resized to one layer
+        *
+        * @param mapDic Image files, one per layer
+        * @param textureSize Width and height of the layers
+        * @param _format Format of the array, VK_FORMAT_R8G8B8A8_UNORM or VK_FORMAT_R8G8B8A8_SRGB (files are decoded and resized as 8 bit RGBA)
+        * @param _device Vulkan device to create the texture on
+        * @param copyQueue Queue the copies and mip generation are submitted to
+        * @param (Optional) _imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
+        * @param (Optional) _viewType Type of the image view (defaults to VK_IMAGE_VIEW_TYPE_2D_ARRAY)
+        * @param (Optional) _imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+        * @param (Optional) threadPool Pool decoding and resizing the files, a temporary one is created if nullptr
+        * @param (Optional) maxDecodedImages Number of resized layers held in host memory at once (staging slots)
+        * @param (Optional) filter Filter used to resize the files to textureSize
+        */
         void buildFromImages(const std::vector<std::string>& mapDic, uint32_t textureSize,
                              VkFormat _format,
                              vks::VulkanDevice *_device,
                              VkQueue copyQueue,
                              VkImageUsageFlags _imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
                              VkImageViewType _viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY,
-                             VkImageLayout _imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL){
+                             VkImageLayout _imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+                             vks::ThreadPool *threadPool = nullptr,
+                             uint32_t maxDecodedImages = 8,
+                             vks::resample::Filter filter = vks::resample::Filter::Bilinear){
 
 
             //build texture array, all texture are resized at a fixed size while added into a layer of the array tex,
             //than mipmaps are genereted
+            // Files are decoded and resized on the cpu as 8 bit RGBA and copied into the layers as they are
+            assert((_format == VK_FORMAT_R8G8B8A8_UNORM) || (_format == VK_FORMAT_R8G8B8A8_SRGB));
+            if ((_format != VK_FORMAT_R8G8B8A8_UNORM) && (_format != VK_FORMAT_R8G8B8A8_SRGB)) {
+                vks::tools::exitFatal("Texture arrays built from image files must use an 8 bit RGBA format (VK_FORMAT_R8G8B8A8_UNORM or VK_FORMAT_R8G8B8A8_SRGB)", "Unsupported format");
+                return;
+            }
             format = _format;
             imageLayout = _imageLayout;
             layerCount = mapDic.size();
@@ -665,153 +684,165 @@ namespace vks
             imageCreateInfo.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | _imageUsageFlags;
             VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-            VkMemoryRequirements memReqs = {};
-            VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-            vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-            memAllocInfo.allocationSize = memReqs.size;
-            memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-            VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-            VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-            for (int l = 0; l < mapDic.size(); l++) {
-                Texture inTex;
-                inTex.loadStbLinearNoSampling(mapDic[l].c_str(), device);
-
-                VkCommandBuffer blitFirstMipCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
-                VkImageBlit firstMipBlit{};
-
-                // Source
-                firstMipBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                firstMipBlit.srcSubresource.layerCount = 1;
-                firstMipBlit.srcSubresource.mipLevel = 0;
-                firstMipBlit.srcSubresource.baseArrayLayer = 0;
-                firstMipBlit.srcOffsets[1].x = inTex.width;
-                firstMipBlit.srcOffsets[1].y = inTex.height;
-                firstMipBlit.srcOffsets[1].z = 1;
-
-                // Destination
-                firstMipBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                firstMipBlit.dstSubresource.layerCount = 1;
-                firstMipBlit.dstSubresource.mipLevel = 0;
-                firstMipBlit.dstSubresource.baseArrayLayer = l;
-                firstMipBlit.dstOffsets[1].x = width;
-                firstMipBlit.dstOffsets[1].y = height;
-                firstMipBlit.dstOffsets[1].z = 1;
-
-                VkImageSubresourceRange firstMipSubRange = {};
-                firstMipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                firstMipSubRange.baseArrayLayer = l;
-                firstMipSubRange.levelCount = 1;
-                firstMipSubRange.layerCount = 1;
-
-                // Transiton current array level to transfer dest
-                vks::tools::setImageLayout(
-                    blitFirstMipCmd,
-                    image,
-                    VK_IMAGE_LAYOUT_UNDEFINED,
-                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                    firstMipSubRange,
-                    VK_PIPELINE_STAGE_TRANSFER_BIT,
-                    VK_PIPELINE_STAGE_HOST_BIT);
-
-                // Blit from source texture
-                vkCmdBlitImage(
-                    blitFirstMipCmd,
-                    inTex.image,
-                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                    image,
-                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                    1,
-                    &firstMipBlit,
-                    VK_FILTER_LINEAR);
-
-                //set layer ready for sampling
-                vks::tools::setImageLayout(
-                    blitFirstMipCmd,
-                    image,
-                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                    imageLayout,
-                    firstMipSubRange);
-
-                device->flushCommandBuffer(blitFirstMipCmd, copyQueue, true);
+            VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation));
+            deviceMemory = allocation.memory;
+
+            // Files are decoded and resized to the layer size on the thread pool (a temporary one if none is given),
+            // straight into one of the slots of a host visible staging buffer. A slot is written again once the copy
+            // of its previous layer has executed, which bounds the host memory used by the upload
+            std::unique_ptr<vks::ThreadPool> ownThreadPool;
+            if (threadPool == nullptr || threadPool->threads.empty()) {
+                ownThreadPool.reset(new vks::ThreadPool());
+                ownThreadPool->setThreadCount(std::max(1u, std::thread::hardware_concurrency()));
+                threadPool = ownThreadPool.get();
+            }
+            const uint32_t slotCount = std::max(maxDecodedImages, 2u);
+            const VkDeviceSize layerSize = (VkDeviceSize)width * height * 4;
+            vks::Buffer staging;
+            VK_CHECK_RESULT(device->createBuffer(
+                VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                &staging,
+                layerSize * slotCount));
+            VK_CHECK_RESULT(staging.map());
+
+            std::vector<std::string> errors(layerCount);
+            std::vector<bool> decodedReady(layerCount, false);
+            std::mutex decodeMutex;
+            std::condition_variable decodeCondition;
+            stbi_set_flip_vertically_on_load(true);
+            uint32_t decodesQueued = 0;
+            auto queueDecode = [&]() {
+                uint32_t layer = decodesQueued++;
+                std::string filename = mapDic[layer];
+                uint8_t *slot = static_cast<uint8_t*>(staging.mapped) + (layer % slotCount) * layerSize;
+                uint32_t size = textureSize;
+                std::string *error = &errors[layer];
+                std::vector<bool> *ready = &decodedReady;
+                std::mutex *mutex = &decodeMutex;
+                std::condition_variable *condition = &decodeCondition;
+                threadPool->threads[layer % threadPool->threads.size()]->addJob([=]() {
+                    ImageData data = decodeStb(filename, 4);
+                    if (data.pixels != NULL) {
+                        VKS_TRACE_ZONE("Image resize");
+                        vks::resample::resizeRGBA8(data.pixels, data.width, data.height, slot, size, size, filter);
+                        stbi_image_free(data.pixels);
+                    }
+                    std::lock_guard<std::mutex> lock(*mutex);
+                    *error = data.error;
+                    (*ready)[layer] = true;
+                    condition->notify_all();
+                });
+            };
+
+            // Copies are submitted in groups of half the slots without waiting, each slot keeps the fence of the submit
+            // reading it and is only waited for when a file is decoded into it again. The mip chain is generated for
+            // all layers at once with the last group
+            const uint32_t groupSize = slotCount / 2;
+            std::vector<VkFence> slotFences(slotCount, VK_NULL_HANDLE);
+            std::vector<std::pair<VkCommandBuffer, VkFence>> submitted;
+            uint32_t submittedLayers = 0;
+            VkCommandBuffer copyCmd = VK_NULL_HANDLE;
+
+            // Queue decodes up to limit into slots whose previous copy has been submitted, stops at the first slot
+            // whose copy is still executing unless wait is set
+            auto refill = [&](uint32_t limit, bool wait) {
+                limit = std::min(limit, std::min(layerCount, submittedLayers + slotCount));
+                while (decodesQueued < limit) {
+                    VkFence fence = slotFences[decodesQueued % slotCount];
+                    if (fence != VK_NULL_HANDLE) {
+                        if (!wait && (vkGetFenceStatus(device->logicalDevice, fence) != VK_SUCCESS))
+                            break;
+                        VKS_TRACE_ZONE("Wait for staging slot");
+                        VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+                    }
+                    queueDecode();
+                }
+            };
+            auto submitCopies = [&](uint32_t layerEnd) {
+                VK_CHECK_RESULT(vkEndCommandBuffer(copyCmd));
+                VkSubmitInfo submitInfo = vks::initializers::submitInfo();
+                submitInfo.commandBufferCount = 1;
+                submitInfo.pCommandBuffers = &copyCmd;
+                VkFence fence = device->acquireFence();
+                VK_CHECK_RESULT(device->queueSubmit(copyQueue, 1, &submitInfo, fence));
+                for (uint32_t i = submittedLayers; i < layerEnd; i++)
+                    slotFences[i % slotCount] = fence;
+                submitted.push_back({ copyCmd, fence });
+                submittedLayers = layerEnd;
+                copyCmd = VK_NULL_HANDLE;
+            };
+            refill(slotCount, false);
+
+            for (uint32_t l = 0; l < layerCount; l++) {
+                if (decodesQueued <= l)
+                    refill(l + 1, true);
+                {
+                    VKS_TRACE_ZONE("Wait for image decode");
+                    std::unique_lock<std::mutex> lock(decodeMutex);
+                    decodeCondition.wait(lock, [&]() { return (bool)decodedReady[l]; });
+                }
+                if (!errors[l].empty())
+                    vks::tools::exitFatal(errors[l], "Image decode failed");
+
+                if (copyCmd == VK_NULL_HANDLE) {
+                    copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+                    if (l == 0) {
+                        // Transition the first level of all layers to transfer dest
+                        VkImageSubresourceRange firstMipSubRange = {};
+                        firstMipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                        firstMipSubRange.levelCount = 1;
+                        firstMipSubRange.layerCount = layerCount;
+                        vks::tools::setImageLayout(
+                            copyCmd,
+                            image,
+                            VK_IMAGE_LAYOUT_UNDEFINED,
+                            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                            firstMipSubRange,
+                            VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                            VK_PIPELINE_STAGE_TRANSFER_BIT);
+                    }
+                }
 
-                vkDestroyImage(device->logicalDevice, inTex.image, nullptr);
-                vkFreeMemory(device->logicalDevice, inTex.deviceMemory, nullptr);
+                VkBufferImageCopy copyRegion = {};
+                copyRegion.bufferOffset = (l % slotCount) * layerSize;
+                copyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                copyRegion.imageSubresource.mipLevel = 0;
+                copyRegion.imageSubresource.baseArrayLayer = l;
+                copyRegion.imageSubresource.layerCount = 1;
+                copyRegion.imageExtent = { width, height, 1 };
+                vkCmdCopyBufferToImage(copyCmd, staging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &copyRegion);
+
+                if (l == layerCount - 1) {
+                    // Copies of earlier groups are ordered before the mip chain by its barriers, as they were submitted to the same queue before
+                    recordMipChain(copyCmd);
+                    submitCopies(l + 1);
+                }
+                else if ((l + 1) % groupSize == 0) {
+                    submitCopies(l + 1);
+                    // Slots whose copies have already executed are written again right away
+                    refill(l + 1 + slotCount, false);
+                }
+            }
 
-                VkCommandBuffer blitCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+            // All decodes have been consumed, make sure no job still holds the locals
+            threadPool->wait();
 
-                // mipmap generation
-                // Copy down mips from n-1 to n
-                for (int32_t i = 1; i < mipLevels; i++)
-                {
-                    VkImageBlit imageBlit{};
-
-                    // Source
-                    imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                    imageBlit.srcSubresource.layerCount = 1;
-                    imageBlit.srcSubresource.mipLevel = i-1;
-                    imageBlit.srcSubresource.baseArrayLayer = l;
-                    imageBlit.srcOffsets[1].x = int32_t(width >> (i - 1));
-                    imageBlit.srcOffsets[1].y = int32_t(height >> (i - 1));
-                    imageBlit.srcOffsets[1].z = 1;
-
-                    // Destination
-                    imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                    imageBlit.dstSubresource.layerCount = 1;
-                    imageBlit.dstSubresource.mipLevel = i;
-                    imageBlit.dstSubresource.baseArrayLayer = l;
-                    imageBlit.dstOffsets[1].x = int32_t(width >> i);
-                    imageBlit.dstOffsets[1].y = int32_t(height >> i);
-                    imageBlit.dstOffsets[1].z = 1;
-
-                    VkImageSubresourceRange mipSubRange = {};
-                    mipSubRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-                    mipSubRange.baseMipLevel = i;
-                    mipSubRange.baseArrayLayer = l;
-                    mipSubRange.levelCount = 1;
-                    mipSubRange.layerCount = 1;
-
-                    // Transiton current mip level to transfer dest
-                    vks::tools::setImageLayout(
-                        blitCmd,
-                        image,
-                        VK_IMAGE_LAYOUT_UNDEFINED,
-                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                        mipSubRange,
-                        VK_PIPELINE_STAGE_TRANSFER_BIT,
-                        VK_PIPELINE_STAGE_HOST_BIT);
-
-                    // Blit from previous level
-                    vkCmdBlitImage(
-                        blitCmd,
-                        image,
-                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                        image,
-                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                        1,
-                        &imageBlit,
-                        VK_FILTER_LINEAR);
-
-                    // Transiton current mip level to transfer source for read in next iteration
-                    vks::tools::setImageLayout(
-                        blitCmd,
-                        image,
-                        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-                        mipSubRange,
-                        VK_PIPELINE_STAGE_HOST_BIT,
-                        VK_PIPELINE_STAGE_TRANSFER_BIT);
+            // Single wait for the whole array, the fences and command buffers go back to the device's pools
+            {
+                VKS_TRACE_ZONE("Wait for texture array upload");
+                std::vector<VkFence> fences;
+                for (auto &submit : submitted)
+                    fences.push_back(submit.second);
+                VK_CHECK_RESULT(vkWaitForFences(device->logicalDevice, static_cast<uint32_t>(fences.size()), fences.data(), VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+                VK_CHECK_RESULT(vkResetFences(device->logicalDevice, static_cast<uint32_t>(fences.size()), fences.data()));
+                device->freeFences.insert(device->freeFences.end(), fences.begin(), fences.end());
+                for (auto &submit : submitted) {
+                    VK_CHECK_RESULT(vkResetCommandBuffer(submit.first, 0));
+                    device->freeCommandBuffers.push_back(submit.first);
                 }
-                //set layer ready for sampling
-                firstMipSubRange.levelCount = mipLevels;
-                vks::tools::setImageLayout(
-                    blitFirstMipCmd,
-                    image,
-                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-                    imageLayout,
-                    firstMipSubRange);
-                device->flushCommandBuffer(blitCmd, copyQueue, true);
             }
+            staging.destroy();
 
             // Create samplers
             VkSamplerCreateInfo samplerCI = vks::initializers::samplerCreateInfo();
@@ -850,13 +881,14 @@ namespace vks
             VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCI, nullptr, &view));
             updateDescriptor();
         }
+
         /**
         * Load a 2D texture array including all mip levels
         *
         * @param filename File to load (supports .ktx and .dds)
         * @param format Vulkan format of the image data stored in the file
         * @param device Vulkan device to create the texture on
-        * @param copyQueue Queue used for the texture staging copy commands (must support transfer)
+        * @param copyQueue Unused, the copy commands are recorded into the device's staging ring and submitted with its next batch
         * @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
         * @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
         *
@@ -868,6 +900,7 @@ namespace vks
             VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
             VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
         {
+            VKS_TRACE_ZONE("Texture load");
 #if defined(__ANDROID__)
             // Textures are stored inside the apk on Android (compressed)
             // So they need to be loaded via the asset manager
@@ -898,40 +931,14 @@ namespace vks
             layerCount = static_cast<uint32_t>(tex2DArray.layers());
             mipLevels = static_cast<uint32_t>(tex2DArray.levels());
 
-            VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-            VkMemoryRequirements memReqs;
-
-            // Create a host-visible staging buffer that contains the raw image data
-            VkBuffer stagingBuffer;
-            VkDeviceMemory stagingMemory;
-
-            VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-            bufferCreateInfo.size = tex2DArray.size();
-            // This buffer is used as a transfer source for the buffer copy
-            bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-            VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-            // Get memory requirements for the staging buffer (alignment, memory type bits)
-            vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-
-            memAllocInfo.allocationSize = memReqs.size;
-            // Get memory type index for a host visible buffer
-            memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-            VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-            VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-            // Copy texture data into staging buffer
-            uint8_t *data;
-            VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-            memcpy(data, tex2DArray.data(), static_cast<size_t>(tex2DArray.size()));
-            vkUnmapMemory(device->logicalDevice, stagingMemory);
+            // Copy the raw image data into the shared staging ring, the copy is recorded into the ring's current batch
+            vks::StagingRing *staging = device->getStagingRing();
+            vks::StagingRegion stagingRegion = staging->stage(tex2DArray.data(), tex2DArray.size(), staging->imageCopyAlignment(gli::block_size(tex2DArray.format())));
+            VkCommandBuffer copyCmd = staging->commandBuffer();
 
             // Setup buffer copy regions for each layer including all of it's miplevels
             std::vector<VkBufferImageCopy> bufferCopyRegions;
-            size_t offset = 0;
+            VkDeviceSize offset = stagingRegion.offset;
 
             for (uint32_t layer = 0; layer < layerCount; layer++)
             {
@@ -974,16 +981,8 @@ namespace vks
 
             VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-            vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-            memAllocInfo.allocationSize = memReqs.size;
-            memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-            VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-            VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-            // Use a separate command buffer for texture loading
-            VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+            VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation));
+            deviceMemory = allocation.memory;
 
             // Image barrier for optimal image (target)
             // Set initial layout for all array layers (faces) of the optimal (target) tiled texture
@@ -1003,7 +1002,7 @@ namespace vks
             // Copy the layers and mip levels from the staging buffer to the optimal tiled image
             vkCmdCopyBufferToImage(
                 copyCmd,
-                stagingBuffer,
+                stagingRegion.buffer,
                 image,
                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                 static_cast<uint32_t>(bufferCopyRegions.size()),
@@ -1018,8 +1017,6 @@ namespace vks
                 imageLayout,
                 subresourceRange);
 
-            device->flushCommandBuffer(copyCmd, copyQueue);
-
             // Create sampler
             VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
             samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
@@ -1047,13 +1044,102 @@ namespace vks
             viewCreateInfo.image = image;
             VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
 
-            // Clean up staging resources
-            vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-            vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
             // Update descriptor image info member that can be used for setting up descriptor sets
             updateDescriptor();
         }
+
+    private:
+        // Generate levels 1..mipLevels-1 of all layers from level 0 (in transfer dst layout),
+        // one blit covering every layer and one barrier per level, and leave the image in imageLayout
+        void recordMipChain(VkCommandBuffer blitCmd)
+        {
+            VkImageSubresourceRange subRange = {};
+            subRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            subRange.baseMipLevel = 0;
+            subRange.levelCount = 1;
+            subRange.layerCount = layerCount;
+
+            // First level of every layer is the source of the chain
+            vks::tools::setImageLayout(
+                blitCmd,
+                image,
+                VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                subRange,
+                VK_PIPELINE_STAGE_TRANSFER_BIT,
+                VK_PIPELINE_STAGE_TRANSFER_BIT);
+
+            if (mipLevels > 1) {
+                // All remaining levels become blit destinations at once
+                subRange.baseMipLevel = 1;
+                subRange.levelCount = mipLevels - 1;
+                vks::tools::setImageLayout(
+                    blitCmd,
+                    image,
+                    VK_IMAGE_LAYOUT_UNDEFINED,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    subRange,
+                    VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT);
+            }
+
+            // Copy down mips from n-1 to n
+            for (uint32_t i = 1; i < mipLevels; i++)
+            {
+                VkImageBlit imageBlit{};
+
+                // Source
+                imageBlit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                imageBlit.srcSubresource.layerCount = layerCount;
+                imageBlit.srcSubresource.mipLevel = i - 1;
+                imageBlit.srcSubresource.baseArrayLayer = 0;
+                imageBlit.srcOffsets[1].x = std::max(int32_t(width >> (i - 1)), 1);
+                imageBlit.srcOffsets[1].y = std::max(int32_t(height >> (i - 1)), 1);
+                imageBlit.srcOffsets[1].z = 1;
+
+                // Destination
+                imageBlit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+                imageBlit.dstSubresource.layerCount = layerCount;
+                imageBlit.dstSubresource.mipLevel = i;
+                imageBlit.dstSubresource.baseArrayLayer = 0;
+                imageBlit.dstOffsets[1].x = std::max(int32_t(width >> i), 1);
+                imageBlit.dstOffsets[1].y = std::max(int32_t(height >> i), 1);
+                imageBlit.dstOffsets[1].z = 1;
+
+                // Blit from previous level
+                vkCmdBlitImage(
+                    blitCmd,
+                    image,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    image,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    1,
+                    &imageBlit,
+                    VK_FILTER_LINEAR);
+
+                // Transiton current mip level to transfer source for read in next iteration
+                subRange.baseMipLevel = i;
+                subRange.levelCount = 1;
+                vks::tools::setImageLayout(
+                    blitCmd,
+                    image,
+                    VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                    VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                    subRange,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT,
+                    VK_PIPELINE_STAGE_TRANSFER_BIT);
+            }
+
+            // Set all levels and layers ready for sampling
+            subRange.baseMipLevel = 0;
+            subRange.levelCount = mipLevels;
+            vks::tools::setImageLayout(
+                blitCmd,
+                image,
+                VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                imageLayout,
+                subRange);
+        }
     };
 
     /** @brief Cube map texture */
@@ -1065,7 +1151,7 @@ namespace vks
         * @param filename File to load (supports .ktx and .dds)
         * @param format Vulkan format of the image data stored in the file
         * @param device Vulkan device to create the texture on
-        * @param copyQueue Queue used for the texture staging copy commands (must support transfer)
+        * @param copyQueue Unused, the copy commands are recorded into the device's staging ring and submitted with its next batch
         * @param (Optional) imageUsageFlags Usage flags for the texture's image (defaults to VK_IMAGE_USAGE_SAMPLED_BIT)
         * @param (Optional) imageLayout Usage layout for the texture (defaults VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
         *
@@ -1078,6 +1164,7 @@ namespace vks
             VkImageUsageFlags imageUsageFlags = VK_IMAGE_USAGE_SAMPLED_BIT,
             VkImageLayout imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
         {
+            VKS_TRACE_ZONE("Texture load");
 #if defined(__ANDROID__)
             // Textures are stored inside the apk on Android (compressed)
             // So they need to be loaded via the asset manager
@@ -1105,40 +1192,14 @@ namespace vks
             height = static_cast<uint32_t>(texCube.extent().y);
             mipLevels = static_cast<uint32_t>(texCube.levels());
 
-            VkMemoryAllocateInfo memAllocInfo = vks::initializers::memoryAllocateInfo();
-            VkMemoryRequirements memReqs;
-
-            // Create a host-visible staging buffer that contains the raw image data
-            VkBuffer stagingBuffer;
-            VkDeviceMemory stagingMemory;
-
-            VkBufferCreateInfo bufferCreateInfo = vks::initializers::bufferCreateInfo();
-            bufferCreateInfo.size = texCube.size();
-            // This buffer is used as a transfer source for the buffer copy
-            bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
-            bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-            VK_CHECK_RESULT(vkCreateBuffer(device->logicalDevice, &bufferCreateInfo, nullptr, &stagingBuffer));
-
-            // Get memory requirements for the staging buffer (alignment, memory type bits)
-            vkGetBufferMemoryRequirements(device->logicalDevice, stagingBuffer, &memReqs);
-
-            memAllocInfo.allocationSize = memReqs.size;
-            // Get memory type index for a host visible buffer
-            memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-
-            VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &stagingMemory));
-            VK_CHECK_RESULT(vkBindBufferMemory(device->logicalDevice, stagingBuffer, stagingMemory, 0));
-
-            // Copy texture data into staging buffer
-            uint8_t *data;
-            VK_CHECK_RESULT(vkMapMemory(device->logicalDevice, stagingMemory, 0, memReqs.size, 0, (void **)&data));
-            memcpy(data, texCube.data(), texCube.size());
-            vkUnmapMemory(device->logicalDevice, stagingMemory);
+            // Copy the raw image data into the shared staging ring, the copy is recorded into the ring's current batch
+            vks::StagingRing *staging = device->getStagingRing();
+            vks::StagingRegion stagingRegion = staging->stage(texCube.data(), texCube.size(), staging->imageCopyAlignment(gli::block_size(texCube.format())));
+            VkCommandBuffer copyCmd = staging->commandBuffer();
 
             // Setup buffer copy regions for each face including all of it's miplevels
             std::vector<VkBufferImageCopy> bufferCopyRegions;
-            size_t offset = 0;
+            VkDeviceSize offset = stagingRegion.offset;
 
             for (uint32_t face = 0; face < 6; face++)
             {
@@ -1185,16 +1246,8 @@ namespace vks
 
             VK_CHECK_RESULT(vkCreateImage(device->logicalDevice, &imageCreateInfo, nullptr, &image));
 
-            vkGetImageMemoryRequirements(device->logicalDevice, image, &memReqs);
-
-            memAllocInfo.allocationSize = memReqs.size;
-            memAllocInfo.memoryTypeIndex = device->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-
-            VK_CHECK_RESULT(vkAllocateMemory(device->logicalDevice, &memAllocInfo, nullptr, &deviceMemory));
-            VK_CHECK_RESULT(vkBindImageMemory(device->logicalDevice, image, deviceMemory, 0));
-
-            // Use a separate command buffer for texture loading
-            VkCommandBuffer copyCmd = device->createCommandBuffer(VK_COMMAND_BUFFER_LEVEL_PRIMARY, true);
+            VK_CHECK_RESULT(device->allocateImageMemory(image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &allocation));
+            deviceMemory = allocation.memory;
 
             // Image barrier for optimal image (target)
             // Set initial layout for all array layers (faces) of the optimal (target) tiled texture
@@ -1214,7 +1267,7 @@ namespace vks
             // Copy the cube map faces from the staging buffer to the optimal tiled image
             vkCmdCopyBufferToImage(
                 copyCmd,
-                stagingBuffer,
+                stagingRegion.buffer,
                 image,
                 VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
                 static_cast<uint32_t>(bufferCopyRegions.size()),
@@ -1229,8 +1282,6 @@ namespace vks
                 imageLayout,
                 subresourceRange);
 
-            device->flushCommandBuffer(copyCmd, copyQueue);
-
             // Create sampler
             VkSamplerCreateInfo samplerCreateInfo = vks::initializers::samplerCreateInfo();
             samplerCreateInfo.magFilter = VK_FILTER_LINEAR;
@@ -1258,10 +1309,6 @@ namespace vks
             viewCreateInfo.image = image;
             VK_CHECK_RESULT(vkCreateImageView(device->logicalDevice, &viewCreateInfo, nullptr, &view));
 
-            // Clean up staging resources
-            vkFreeMemory(device->logicalDevice, stagingMemory, nullptr);
-            vkDestroyBuffer(device->logicalDevice, stagingBuffer, nullptr);
-
             // Update descriptor image info member that can be used for setting up descriptor sets
             updateDescriptor();
         }
@@ -0,0 +1,230 @@
+/*
+* Frame time benchmark
+*
+* Records cpu and gpu times of every frame after a warm-up phase and writes statistics and
+* the raw per-frame values when finished
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+namespace vks
+{
+	class Benchmark
+	{
+	public:
+		struct Frame
+		{
+			/** @brief Cpu time of the frame in milliseconds */
+			double cpuTime = 0.0;
+			/** @brief Gpu time of the frame in milliseconds, negative if it could not be measured */
+			double gpuTime = -1.0;
+		};
+
+		struct Statistics
+		{
+			double mean = 0.0;
+			double median = 0.0;
+			double p95 = 0.0;
+			double p99 = 0.0;
+			double max = 0.0;
+			size_t count = 0;
+		};
+
+		/** @brief Set to true to record frames */
+		bool active = false;
+		/** @brief Number of frames rendered before recording starts */
+		uint32_t warmupFrames = 60;
+		/** @brief Number of frames to record, 0 to only limit the recording by duration */
+		uint32_t frameCount = 0;
+		/** @brief Recording duration in seconds, 0 to only limit the recording by frame count */
+		double duration = 10.0;
+		/** @brief File the results are written to, json if the name ends with .json and csv otherwise (stdout only if empty) */
+		std::string filename;
+
+		std::vector<Frame> frames;
+
+		/** @brief Index the frame currently being rendered will get, -1 if it is not recorded */
+		int64_t currentFrame() const
+		{
+			if (!active || (warmupCount < warmupFrames) || finished())
+			{
+				return -1;
+			}
+			return (int64_t)frames.size();
+		}
+
+		/**
+		* Add the cpu time of the frame that has just been rendered
+		*
+		* @param cpuTime Cpu time of the frame in milliseconds
+		*/
+		void addFrame(double cpuTime)
+		{
+			if (!active || finished())
+			{
+				return;
+			}
+			if (warmupCount < warmupFrames)
+			{
+				warmupCount++;
+				return;
+			}
+			Frame frame;
+			frame.cpuTime = cpuTime;
+			frames.push_back(frame);
+			elapsed += cpuTime / 1000.0;
+		}
+
+		/**
+		* Set the gpu time of a recorded frame, known once the frame has finished executing
+		*
+		* @param frame Index of the frame as returned by currentFrame when it was rendered
+		* @param gpuTime Gpu time of the frame in milliseconds
+		*/
+		void setGpuTime(int64_t frame, double gpuTime)
+		{
+			if ((frame >= 0) && (frame < (int64_t)frames.size()))
+			{
+				frames[frame].gpuTime = gpuTime;
+			}
+		}
+
+		/** @brief True once the requested number of frames or the duration has been recorded */
+		bool finished() const
+		{
+			if (!active || ((frameCount == 0) && (duration <= 0.0)))
+			{
+				return false;
+			}
+			return ((frameCount > 0) && (frames.size() >= frameCount)) || ((duration > 0.0) && (elapsed >= duration));
+		}
+
+		/** @brief Statistics of the recorded cpu (or gpu) times, frames without gpu time are skipped */
+		Statistics statistics(bool gpu) const
+		{
+			std::vector<double> times;
+			times.reserve(frames.size());
+			for (auto &frame : frames)
+			{
+				double time = gpu ? frame.gpuTime : frame.cpuTime;
+				if (time >= 0.0)
+				{
+					times.push_back(time);
+				}
+			}
+			Statistics stats;
+			stats.count = times.size();
+			if (times.empty())
+			{
+				return stats;
+			}
+			std::sort(times.begin(), times.end());
+			double sum = 0.0;
+			for (auto time : times)
+			{
+				sum += time;
+			}
+			stats.mean = sum / times.size();
+			stats.median = percentile(times, 0.5);
+			stats.p95 = percentile(times, 0.95);
+			stats.p99 = percentile(times, 0.99);
+			stats.max = times.back();
+			return stats;
+		}
+
+		/** @brief Print the statistics to stdout and write them with the raw frame times to filename */
+		void save() const
+		{
+			Statistics cpu = statistics(false);
+			Statistics gpu = statistics(true);
+			std::cout << std::fixed << std::setprecision(3);
+			std::cout << "Benchmark: " << frames.size() << " frames after " << warmupCount << " warm-up frames" << std::endl;
+			printStatistics("cpu", cpu);
+			printStatistics("gpu", gpu);
+
+			if (filename.empty())
+			{
+				return;
+			}
+			std::ofstream file(filename);
+			if (!file.is_open())
+			{
+				std::cerr << "Could not write benchmark results to " << filename << std::endl;
+				return;
+			}
+			file << std::fixed << std::setprecision(4);
+			const std::string ext = ".json";
+			if ((filename.size() >= ext.size()) && (filename.compare(filename.size() - ext.size(), ext.size(), ext) == 0))
+			{
+				file << "{\n";
+				file << "\t\"warmupFrames\": " << warmupCount << ",\n";
+				writeStatistics(file, "cpu", cpu);
+				writeStatistics(file, "gpu", gpu);
+				file << "\t\"frames\": [\n";
+				for (size_t i = 0; i < frames.size(); i++)
+				{
+					file << "\t\t{ \"cpu\": " << frames[i].cpuTime << ", \"gpu\": ";
+					if (frames[i].gpuTime >= 0.0)
+					{
+						file << frames[i].gpuTime;
+					}
+					else
+					{
+						file << "null";
+					}
+					file << " }" << ((i + 1 < frames.size()) ? "," : "") << "\n";
+				}
+				file << "\t]\n}\n";
+			}
+			else
+			{
+				file << "frame,cpu_ms,gpu_ms\n";
+				for (size_t i = 0; i < frames.size(); i++)
+				{
+					file << i << "," << frames[i].cpuTime << ",";
+					if (frames[i].gpuTime >= 0.0)
+					{
+						file << frames[i].gpuTime;
+					}
+					file << "\n";
+				}
+			}
+		}
+
+	private:
+		uint32_t warmupCount = 0;
+		double elapsed = 0.0;
+
+		// Nearest rank percentile of sorted values
+		static double percentile(const std::vector<double> &sorted, double p)
+		{
+			size_t rank = (size_t)(p * (double)(sorted.size() - 1) + 0.5);
+			return sorted[std::min(rank, sorted.size() - 1)];
+		}
+
+		static void printStatistics(const char *name, const Statistics &stats)
+		{
+			if (stats.count == 0)
+			{
+				std::cout << " " << name << ": not measured" << std::endl;
+				return;
+			}
+			std::cout << " " << name << " ms: mean " << stats.mean << ", median " << stats.median << ", p95 " << stats.p95 << ", p99 " << stats.p99 << ", max " << stats.max << std::endl;
+		}
+
+		static void writeStatistics(std::ofstream &file, const char *name, const Statistics &stats)
+		{
+			file << "\t\"" << name << "\": { \"count\": " << stats.count << ", \"mean\": " << stats.mean << ", \"median\": " << stats.median
+				<< ", \"p95\": " << stats.p95 << ", \"p99\": " << stats.p99 << ", \"max\": " << stats.max << " },\n";
+		}
+	};
+}
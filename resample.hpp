@@ -0,0 +1,296 @@
+/*
+* Cpu image resampler
+*
+* Separable resize of 8 bit RGBA images with box, bilinear (tent) and Lanczos filters. Filters are
+* widened when minifying so every source pixel contributes. Inner loops use AVX2 or SSE2 when the
+* compiler targets them, with a scalar fallback for other architectures
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <algorithm>
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VKS_RESAMPLE_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define VKS_RESAMPLE_SSE2
+#endif
+
+namespace vks
+{
+	namespace resample
+	{
+		enum class Filter
+		{
+			/** @brief Average of the covered source pixels, nearest neighbour when magnifying */
+			Box,
+			/** @brief Tent filter, bilinear interpolation when magnifying */
+			Bilinear,
+			/** @brief Windowed sinc with three lobes, sharpest result at the highest cost */
+			Lanczos3
+		};
+
+		/** @brief Radius of a filter in source pixels, before widening for minification */
+		inline float filterRadius(Filter filter)
+		{
+			switch (filter)
+			{
+			case Filter::Box:
+				return 0.5f;
+			case Filter::Bilinear:
+				return 1.0f;
+			default:
+				return 3.0f;
+			}
+		}
+
+		inline float filterWeight(Filter filter, float x)
+		{
+			x = fabsf(x);
+			switch (filter)
+			{
+			case Filter::Box:
+				return (x <= 0.5f) ? 1.0f : 0.0f;
+			case Filter::Bilinear:
+				return std::max(0.0f, 1.0f - x);
+			default:
+				if (x < 1e-6f)
+				{
+					return 1.0f;
+				}
+				if (x >= 3.0f)
+				{
+					return 0.0f;
+				}
+				const float px = 3.14159265358979f * x;
+				return 3.0f * sinf(px) * sinf(px / 3.0f) / (px * px);
+			}
+		}
+
+		/** @brief Normalized weights of the source pixels contributing to each destination pixel along one axis */
+		struct Contributions
+		{
+			std::vector<uint32_t> first;
+			std::vector<uint32_t> count;
+			/** @brief maxCount weights per destination pixel */
+			std::vector<float> weights;
+			uint32_t maxCount = 0;
+		};
+
+		inline Contributions computeContributions(uint32_t srcSize, uint32_t dstSize, Filter filter)
+		{
+			Contributions contributions;
+			const float ratio = (float)srcSize / (float)dstSize;
+			const float scale = std::max(ratio, 1.0f);
+			const float radius = filterRadius(filter) * scale;
+			contributions.maxCount = (uint32_t)ceilf(2.0f * radius) + 3;
+			contributions.first.resize(dstSize);
+			contributions.count.resize(dstSize);
+			contributions.weights.assign((size_t)dstSize * contributions.maxCount, 0.0f);
+
+			for (uint32_t i = 0; i < dstSize; i++)
+			{
+				// Pixel centers are at +0.5
+				const float center = ((float)i + 0.5f) * ratio;
+				int32_t first = std::max(0, (int32_t)floorf(center - radius));
+				const int32_t last = std::min((int32_t)srcSize - 1, (int32_t)ceilf(center + radius));
+				float *weights = &contributions.weights[(size_t)i * contributions.maxCount];
+				uint32_t count = 0;
+				float sum = 0.0f;
+				for (int32_t j = first; (j <= last) && (count < contributions.maxCount); j++)
+				{
+					weights[count] = filterWeight(filter, ((float)j + 0.5f - center) / scale);
+					sum += weights[count];
+					count++;
+				}
+				if (sum == 0.0f)
+				{
+					// No source pixel inside the filter, fall back to the nearest one
+					first = std::min((int32_t)srcSize - 1, (int32_t)center);
+					count = 1;
+					weights[0] = sum = 1.0f;
+				}
+				for (uint32_t k = 0; k < count; k++)
+				{
+					weights[k] /= sum;
+				}
+				contributions.first[i] = (uint32_t)first;
+				contributions.count[i] = count;
+			}
+			return contributions;
+		}
+
+		// Convert count bytes to floats
+		inline void bytesToFloats(const uint8_t *src, float *dst, size_t count)
+		{
+			size_t i = 0;
+#if defined(VKS_RESAMPLE_SSE2)
+			const __m128i zero = _mm_setzero_si128();
+			for (; i + 16 <= count; i += 16)
+			{
+				__m128i bytes = _mm_loadu_si128((const __m128i*)(src + i));
+				__m128i lo = _mm_unpacklo_epi8(bytes, zero);
+				__m128i hi = _mm_unpackhi_epi8(bytes, zero);
+				_mm_storeu_ps(dst + i, _mm_cvtepi32_ps(_mm_unpacklo_epi16(lo, zero)));
+				_mm_storeu_ps(dst + i + 4, _mm_cvtepi32_ps(_mm_unpackhi_epi16(lo, zero)));
+				_mm_storeu_ps(dst + i + 8, _mm_cvtepi32_ps(_mm_unpacklo_epi16(hi, zero)));
+				_mm_storeu_ps(dst + i + 12, _mm_cvtepi32_ps(_mm_unpackhi_epi16(hi, zero)));
+			}
+#endif
+			for (; i < count; i++)
+			{
+				dst[i] = (float)src[i];
+			}
+		}
+
+		// Round count floats to the nearest byte, clamped to [0, 255]
+		inline void floatsToBytes(const float *src, uint8_t *dst, size_t count)
+		{
+			size_t i = 0;
+#if defined(VKS_RESAMPLE_SSE2)
+			// Rounds half up like the scalar path
+			const __m128 half = _mm_set1_ps(0.5f);
+			for (; i + 16 <= count; i += 16)
+			{
+				__m128i a = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(src + i), half));
+				__m128i b = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(src + i + 4), half));
+				__m128i c = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(src + i + 8), half));
+				__m128i d = _mm_cvttps_epi32(_mm_add_ps(_mm_loadu_ps(src + i + 12), half));
+				// Saturating packs clamp negative lobes and overshoot
+				__m128i bytes = _mm_packus_epi16(_mm_packs_epi32(a, b), _mm_packs_epi32(c, d));
+				_mm_storeu_si128((__m128i*)(dst + i), bytes);
+			}
+#endif
+			for (; i < count; i++)
+			{
+				float value = std::min(255.0f, std::max(0.0f, src[i] + 0.5f));
+				dst[i] = (uint8_t)value;
+			}
+		}
+
+		// Filter one row of RGBA pixels horizontally
+		inline void filterRow(const float *src, float *dst, uint32_t dstWidth, const Contributions &contributions)
+		{
+			for (uint32_t x = 0; x < dstWidth; x++)
+			{
+				const float *weights = &contributions.weights[(size_t)x * contributions.maxCount];
+				const float *pixel = src + (size_t)contributions.first[x] * 4;
+				const uint32_t count = contributions.count[x];
+#if defined(VKS_RESAMPLE_SSE2)
+				// One pixel (four channels) per register
+				__m128 sum = _mm_setzero_ps();
+				for (uint32_t k = 0; k < count; k++)
+				{
+					sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(pixel + k * 4)));
+				}
+				_mm_storeu_ps(dst + (size_t)x * 4, sum);
+#else
+				float sum[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+				for (uint32_t k = 0; k < count; k++)
+				{
+					for (uint32_t c = 0; c < 4; c++)
+					{
+						sum[c] += weights[k] * pixel[k * 4 + c];
+					}
+				}
+				memcpy(dst + (size_t)x * 4, sum, sizeof(sum));
+#endif
+			}
+		}
+
+		// dst += weight * src over count floats
+		inline void accumulateRow(const float *src, float weight, float *dst, size_t count)
+		{
+			size_t i = 0;
+#if defined(VKS_RESAMPLE_AVX2)
+			const __m256 w8 = _mm256_set1_ps(weight);
+			for (; i + 8 <= count; i += 8)
+			{
+				_mm256_storeu_ps(dst + i, _mm256_add_ps(_mm256_loadu_ps(dst + i), _mm256_mul_ps(w8, _mm256_loadu_ps(src + i))));
+			}
+#endif
+#if defined(VKS_RESAMPLE_SSE2)
+			const __m128 w4 = _mm_set1_ps(weight);
+			for (; i + 4 <= count; i += 4)
+			{
+				_mm_storeu_ps(dst + i, _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(w4, _mm_loadu_ps(src + i))));
+			}
+#endif
+			for (; i < count; i++)
+			{
+				dst[i] += weight * src[i];
+			}
+		}
+
+		/**
+		* Resize an 8 bit RGBA image
+		*
+		* @param src Source pixels, tightly packed rows
+		* @param srcWidth Width of the source image
+		* @param srcHeight Height of the source image
+		* @param dst Destination pixels, e.g. mapped staging memory
+		* @param dstWidth Width of the destination image
+		* @param dstHeight Height of the destination image
+		* @param (Optional) filter Filter used for both axes (Defaults to Filter::Bilinear)
+		* @param (Optional) dstRowPitch Bytes between destination rows, 0 for tightly packed rows
+		*
+		* @note Allocates only a few rows of intermediate storage, safe to call from several threads at once
+		*/
+		inline void resizeRGBA8(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight, uint8_t *dst, uint32_t dstWidth, uint32_t dstHeight, Filter filter = Filter::Bilinear, size_t dstRowPitch = 0)
+		{
+			const size_t srcRowSize = (size_t)srcWidth * 4;
+			const size_t dstRowSize = (size_t)dstWidth * 4;
+			if (dstRowPitch == 0)
+			{
+				dstRowPitch = dstRowSize;
+			}
+			if ((srcWidth == dstWidth) && (srcHeight == dstHeight))
+			{
+				for (uint32_t y = 0; y < dstHeight; y++)
+				{
+					memcpy(dst + y * dstRowPitch, src + y * srcRowSize, dstRowSize);
+				}
+				return;
+			}
+
+			const Contributions horizontal = computeContributions(srcWidth, dstWidth, filter);
+			const Contributions vertical = computeContributions(srcHeight, dstHeight, filter);
+
+			// Horizontally filtered source rows, kept in a ring as large as the vertical filter
+			const uint32_t ringSize = vertical.maxCount;
+			std::vector<float> ring((size_t)ringSize * dstRowSize);
+			std::vector<int64_t> ringRows(ringSize, -1);
+			std::vector<float> srcRow(srcRowSize);
+			std::vector<float> dstRow(dstRowSize);
+
+			for (uint32_t y = 0; y < dstHeight; y++)
+			{
+				const float *weights = &vertical.weights[(size_t)y * vertical.maxCount];
+				std::fill(dstRow.begin(), dstRow.end(), 0.0f);
+				for (uint32_t k = 0; k < vertical.count[y]; k++)
+				{
+					const uint32_t row = vertical.first[y] + k;
+					const uint32_t slot = row % ringSize;
+					float *filtered = &ring[(size_t)slot * dstRowSize];
+					if (ringRows[slot] != row)
+					{
+						bytesToFloats(src + row * srcRowSize, srcRow.data(), srcRowSize);
+						filterRow(srcRow.data(), filtered, dstWidth, horizontal);
+						ringRows[slot] = row;
+					}
+					accumulateRow(filtered, weights[k], dstRow.data(), dstRowSize);
+				}
+				floatsToBytes(dstRow.data(), dst + y * dstRowPitch, dstRowSize);
+			}
+		}
+	}
+}
@@ -6,6 +6,8 @@
 * This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
 */
 
+#pragma once
+
 #include <vector>
 #include <thread>
 #include <queue>
@@ -13,6 +15,8 @@
 #include <condition_variable>
 #include <functional>
 
+#include "trace.hpp"
+
 // make_unique is not available in C++11
 // Taken from Herb Sutter's blog (https://herbsutter.com/gotw/_102/)
 template<typename T, typename ...Args>
@@ -35,6 +39,7 @@ namespace vks
 		// Loop through all remaining jobs
 		void queueLoop()
 		{
+			vks::trace::setThreadName("Thread pool worker");
 			while (true)
 			{
 				std::function<void()> job;
@@ -48,7 +53,10 @@ namespace vks
 					job = jobQueue.front();
 				}
 
-				job();
+				{
+					VKS_TRACE_ZONE("Thread pool job");
+					job();
+				}
 
 				{
 					std::lock_guard<std::mutex> lock(queueMutex);
@@ -0,0 +1,208 @@
+/*
+* Scoped cpu zones with Chrome trace event export
+*
+* Zones are recorded into a ring buffer per thread without locking and written in the trace event
+* format read by chrome://tracing and Perfetto. When tracing is disabled a zone costs a single
+* relaxed atomic load
+*
+* This code is licensed under the MIT license (MIT) (http://opensource.org/licenses/MIT)
+*/
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+
+#define VKS_TRACE_CONCAT_INNER(a, b) a##b
+#define VKS_TRACE_CONCAT(a, b) VKS_TRACE_CONCAT_INNER(a, b)
+/** @brief Record a zone from this line to the end of the enclosing scope, name must be a string literal */
+#define VKS_TRACE_ZONE(name) vks::trace::Zone VKS_TRACE_CONCAT(traceZone, __LINE__)(name)
+
+namespace vks
+{
+	namespace trace
+	{
+		/** @brief Number of zones kept per thread, older zones are overwritten (must be a power of two) */
+		const uint32_t threadCapacity = 1 << 16;
+
+		struct Event
+		{
+			const char *name;
+			// Nanoseconds since tracing was enabled
+			uint64_t start;
+			uint64_t end;
+		};
+
+		// Ring of zones written by a single thread
+		struct ThreadBuffer
+		{
+			uint32_t id;
+			std::string name;
+			std::vector<Event> events;
+			std::atomic<uint64_t> written;
+		};
+
+		struct Registry
+		{
+			std::atomic<bool> enabled;
+			std::chrono::steady_clock::time_point epoch;
+			std::mutex mutex;
+			std::vector<std::unique_ptr<ThreadBuffer>> threads;
+		};
+
+		inline Registry& registry()
+		{
+			static Registry instance{};
+			return instance;
+		}
+
+		/** @brief True if zones are being recorded */
+		inline bool enabled()
+		{
+			return registry().enabled.load(std::memory_order_relaxed);
+		}
+
+		/** @brief Start recording zones, timestamps are relative to this call */
+		inline void enable()
+		{
+			Registry &reg = registry();
+			reg.epoch = std::chrono::steady_clock::now();
+			reg.enabled.store(true, std::memory_order_release);
+		}
+
+		inline uint64_t now()
+		{
+			return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - registry().epoch).count();
+		}
+
+		// Buffer of the calling thread, registered on first use and kept after the thread exits
+		inline ThreadBuffer* threadBuffer()
+		{
+			static thread_local ThreadBuffer *buffer = nullptr;
+			if (!buffer)
+			{
+				Registry &reg = registry();
+				std::lock_guard<std::mutex> lock(reg.mutex);
+				std::unique_ptr<ThreadBuffer> threadBuffer(new ThreadBuffer());
+				threadBuffer->id = static_cast<uint32_t>(reg.threads.size());
+				threadBuffer->events.resize(threadCapacity);
+				threadBuffer->written.store(0, std::memory_order_relaxed);
+				buffer = threadBuffer.get();
+				reg.threads.push_back(std::move(threadBuffer));
+			}
+			return buffer;
+		}
+
+		/** @brief Name the calling thread in the trace */
+		inline void setThreadName(const std::string &name)
+		{
+			if (enabled())
+			{
+				ThreadBuffer *buffer = threadBuffer();
+				std::lock_guard<std::mutex> lock(registry().mutex);
+				buffer->name = name;
+			}
+		}
+
+		/** @brief Records the time between construction and destruction if tracing is enabled */
+		class Zone
+		{
+		public:
+			explicit Zone(const char *name)
+			{
+				if (enabled())
+				{
+					this->name = name;
+					start = now();
+				}
+			}
+
+			~Zone()
+			{
+				if (name)
+				{
+					ThreadBuffer *buffer = threadBuffer();
+					uint64_t index = buffer->written.load(std::memory_order_relaxed);
+					Event &event = buffer->events[index & (threadCapacity - 1)];
+					event.name = name;
+					event.start = start;
+					event.end = now();
+					buffer->written.store(index + 1, std::memory_order_release);
+				}
+			}
+
+			Zone(const Zone&) = delete;
+			Zone& operator=(const Zone&) = delete;
+
+		private:
+			const char *name = nullptr;
+			uint64_t start = 0;
+		};
+
+		inline void writeString(std::ofstream &file, const std::string &str)
+		{
+			file << '"';
+			for (char c : str)
+			{
+				if ((c == '"') || (c == '\\'))
+				{
+					file << '\\';
+				}
+				file << c;
+			}
+			file << '"';
+		}
+
+		/**
+		* Write the recorded zones of all threads in the trace event format
+		*
+		* @param filename Name of the json file to write
+		*
+		* @return True if the file has been written
+		*
+		* @note Zones recorded by other threads while writing may be torn, call when rendering and jobs have stopped
+		*/
+		inline bool write(const std::string &filename)
+		{
+			std::ofstream file(filename);
+			if (!file.is_open())
+			{
+				return false;
+			}
+			Registry &reg = registry();
+			std::lock_guard<std::mutex> lock(reg.mutex);
+			file << std::fixed << std::setprecision(3);
+			file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+			bool first = true;
+			for (auto &thread : reg.threads)
+			{
+				if (!thread->name.empty())
+				{
+					file << (first ? "" : ",\n") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread->id << ",\"args\":{\"name\":";
+					writeString(file, thread->name);
+					file << "}}";
+					first = false;
+				}
+				uint64_t written = thread->written.load(std::memory_order_acquire);
+				uint64_t begin = (written > threadCapacity) ? written - threadCapacity : 0;
+				for (uint64_t i = begin; i < written; i++)
+				{
+					const Event &event = thread->events[i & (threadCapacity - 1)];
+					file << (first ? "" : ",\n") << "{\"name\":";
+					writeString(file, event.name);
+					file << ",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":" << thread->id
+						<< ",\"ts\":" << (double)event.start / 1000.0 << ",\"dur\":" << (double)(event.end - event.start) / 1000.0 << "}";
+					first = false;
+				}
+			}
+			file << "\n]}\n";
+			return true;
+		}
+	}
+}
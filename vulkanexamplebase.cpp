@@ -25,24 +25,42 @@ VkResult VulkanExampleBase::createInstance(bool enableValidation)
 	appInfo.pEngineName = name.c_str();
 	appInfo.apiVersion = VK_API_VERSION_1_0;
 
-	std::vector<const char*> instanceExtensions = { VK_KHR_SURFACE_EXTENSION_NAME };
+	std::vector<const char*> instanceExtensions;
 
-	// Enable surface extensions depending on os
+	// Enable surface extensions depending on os, headless mode renders to offscreen images and needs none
+	if (!settings.headless)
+	{
+		instanceExtensions.push_back(VK_KHR_SURFACE_EXTENSION_NAME);
 #if defined(_WIN32)
-	instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WIN32_SURFACE_EXTENSION_NAME);
 #elif defined(__ANDROID__)
-	instanceExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_ANDROID_SURFACE_EXTENSION_NAME);
 #elif defined(_DIRECT2DISPLAY)
-	instanceExtensions.push_back(VK_KHR_DISPLAY_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_DISPLAY_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	instanceExtensions.push_back(VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_WAYLAND_SURFACE_EXTENSION_NAME);
 #elif defined(__linux__)
-	instanceExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_KHR_XCB_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_IOS_MVK)
-    instanceExtensions.push_back(VK_MVK_IOS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_MVK_IOS_SURFACE_EXTENSION_NAME);
 #elif defined(VK_USE_PLATFORM_MACOS_MVK)
-    instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
+		instanceExtensions.push_back(VK_MVK_MACOS_SURFACE_EXTENSION_NAME);
 #endif
+	}
+
+	// Needed to query heap budgets (VK_EXT_memory_budget), enabled if available
+	uint32_t instanceExtensionCount = 0;
+	vkEnumerateInstanceExtensionProperties(nullptr, &instanceExtensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableInstanceExtensions(instanceExtensionCount);
+	vkEnumerateInstanceExtensionProperties(nullptr, &instanceExtensionCount, availableInstanceExtensions.data());
+	for (auto &extension : availableInstanceExtensions)
+	{
+		if (strcmp(extension.extensionName, VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME) == 0)
+		{
+			instanceExtensions.push_back(VK_KHR_GET_PHYSICAL_DEVICE_PROPERTIES_2_EXTENSION_NAME);
+			break;
+		}
+	}
 
 	VkInstanceCreateInfo instanceCreateInfo = {};
 	instanceCreateInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -113,6 +131,8 @@ void VulkanExampleBase::createCommandBuffers()
 			static_cast<uint32_t>(drawCmdBuffers.size()));
 
 	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, drawCmdBuffers.data()));
+	// Recorded by the derived class' buildCommandBuffers right after creation
+	drawCmdBufferVersions.assign(drawCmdBuffers.size(), commandBufferStateVersions());
 }
 
 void VulkanExampleBase::destroyCommandBuffers()
@@ -151,13 +171,30 @@ void VulkanExampleBase::flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueu
 	
 	VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
 
+	// Pending staging copies may be sources of the flushed commands
+	if (vulkanDevice->stagingRing)
+	{
+		vulkanDevice->stagingRing->submit();
+	}
+
 	VkSubmitInfo submitInfo = {};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
-
-	VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	// The flushed commands may acquire asynchronous uploads
+	std::vector<VkSemaphore> waitSemaphores;
+	std::vector<VkPipelineStageFlags> waitStages;
+	vulkanDevice->takeUploadWaits(waitSemaphores, waitStages);
+	submitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+	submitInfo.pWaitSemaphores = waitSemaphores.data();
+	submitInfo.pWaitDstStageMask = waitStages.data();
+
+	// Only wait for this submission, frames in flight on the same queue keep running
+	VkFence fence = vulkanDevice->acquireFence();
+	VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &submitInfo, fence));
+	VK_CHECK_RESULT(vkWaitForFences(device, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
+	VK_CHECK_RESULT(vkResetFences(device, 1, &fence));
+	vulkanDevice->freeFences.push_back(fence);
 
 	if (free)
 	{
@@ -165,6 +202,40 @@ void VulkanExampleBase::flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueu
 	}
 }
 
+VkResult VulkanExampleBase::queueSubmit(uint32_t submitCount, const VkSubmitInfo *submits, VkFence fence)
+{
+	return vulkanDevice->queueSubmit(queue, submitCount, submits, fence);
+}
+
+void VulkanExampleBase::submitDrawCommandBuffers(uint32_t commandBufferCount, const VkCommandBuffer *commandBuffers, VkFence fence)
+{
+	VkSubmitInfo frameSubmitInfo = submitInfo;
+	frameSubmitInfo.commandBufferCount = commandBufferCount;
+	frameSubmitInfo.pCommandBuffers = commandBuffers;
+	// The overlay is drawn on top of the frame's output by the same submission, presentation waits for both
+	std::vector<VkCommandBuffer> frameCmdBuffers;
+	if (drawsTextOverlay())
+	{
+		frameCmdBuffers.assign(commandBuffers, commandBuffers + commandBufferCount);
+		frameCmdBuffers.push_back(textOverlayCmdBuffers[currentBuffer]);
+		frameSubmitInfo.commandBufferCount = static_cast<uint32_t>(frameCmdBuffers.size());
+		frameSubmitInfo.pCommandBuffers = frameCmdBuffers.data();
+	}
+	// Uploads acquired by the frame's command buffers are waited for on the gpu
+	std::vector<VkSemaphore> waitSemaphores(submitInfo.pWaitSemaphores, submitInfo.pWaitSemaphores + submitInfo.waitSemaphoreCount);
+	std::vector<VkPipelineStageFlags> waitStages(submitInfo.pWaitDstStageMask, submitInfo.pWaitDstStageMask + submitInfo.waitSemaphoreCount);
+	vulkanDevice->takeUploadWaits(waitSemaphores, waitStages);
+	frameSubmitInfo.waitSemaphoreCount = static_cast<uint32_t>(waitSemaphores.size());
+	frameSubmitInfo.pWaitSemaphores = waitSemaphores.data();
+	frameSubmitInfo.pWaitDstStageMask = waitStages.data();
+	VK_CHECK_RESULT(queueSubmit(1, &frameSubmitInfo, fence));
+}
+
+void VulkanExampleBase::submitDrawCommandBuffer()
+{
+	submitDrawCommandBuffers(1, &drawCmdBuffers[currentBuffer]);
+}
+
 void VulkanExampleBase::createPipelineCache()
 {
 	VkPipelineCacheCreateInfo pipelineCacheCreateInfo = {};
@@ -179,7 +250,18 @@ void VulkanExampleBase::prepare()
 		vks::debugmarker::setup(device);
 	}
 	createCommandPool();
+	setupFrameTimestamps();
 	setupSwapChain();
+	if (settings.profiler)
+	{
+		vulkanDevice->profiler = new vks::GpuProfiler(device, physicalDevice, vulkanDevice->queueFamilyIndices.graphics, swapChain.imageCount);
+		vulkanDevice->profiler->deferDestruction = [this](std::function<void()> release) { vulkanDevice->retire(release); };
+		vulkanDevice->profiler->queueSubmit = [this](VkQueue queue, uint32_t submitCount, const VkSubmitInfo *submits, VkFence fence) { return vulkanDevice->queueSubmit(queue, submitCount, submits, fence); };
+		if (!vulkanDevice->profiler->supported())
+		{
+			std::cout << "Timestamps are not supported by the graphics queue, profiler scopes are not measured" << std::endl;
+		}
+	}
 	createCommandBuffers();
 	setupDepthStencil();
 	setupRenderPass();
@@ -200,9 +282,11 @@ void VulkanExampleBase::prepare()
 			depthFormat,
 			&width,
 			&height,
-			shaderStages
+			shaderStages,
+			swapChain.presentLayout
 			);
 		updateTextOverlay();
+		buildTextOverlayCommandBuffers();
 	}
 }
 
@@ -229,14 +313,21 @@ void VulkanExampleBase::renderFrame()
     if (viewUpdated)
     {
         viewUpdated = false;
+        VKS_TRACE_ZONE("viewChanged");
         viewChanged();
     }
-    render();
+    {
+        VKS_TRACE_ZONE("render");
+        render();
+    }
     frameCounter++;
     auto tEnd = std::chrono::high_resolution_clock::now();
     auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
     frameTimer = tDiff / 1000.0f;
-    camera.update(frameTimer);
+    {
+        VKS_TRACE_ZONE("camera.update");
+        camera.update(frameTimer);
+    }
     if (camera.moving())
     {
         viewUpdated = true;
@@ -265,15 +356,30 @@ void VulkanExampleBase::renderLoop()
 {
 	destWidth = width;
 	destHeight = height;
+	if (settings.simulationThread)
+	{
+		startSimulation();
+	}
+	if (settings.headless)
+	{
+		renderLoopHeadless();
+		stopSimulation();
+		return;
+	}
 #if defined(_WIN32)
 	MSG msg;
 	bool quitMessageReceived = false;
 	while (!quitMessageReceived)
 	{
 		auto tStart = std::chrono::high_resolution_clock::now();
+		if (settings.simulationThread)
+		{
+			consumeSimulationState();
+		}
 		if (viewUpdated)
 		{
 			viewUpdated = false;
+			VKS_TRACE_ZONE("viewChanged");
 			viewChanged();
 		}
 
@@ -289,18 +395,33 @@ void VulkanExampleBase::renderLoop()
 			}
 		}
 
-		render();
+		{
+			VKS_TRACE_ZONE("render");
+			render();
+		}
 		frameCounter++;
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 		frameTimer = (float)tDiff / 1000.0f;
-		camera.update(frameTimer);
+		if (benchmark.active)
+		{
+			benchmark.addFrame(tDiff);
+			if (benchmark.finished())
+			{
+				quitMessageReceived = true;
+			}
+		}
+		if (!settings.simulationThread)
+		{
+			VKS_TRACE_ZONE("camera.update");
+			camera.update(frameTimer);
+		}
 		if (camera.moving())
 		{
 			viewUpdated = true;
 		}
 		// Convert to clamped timer value
-		if (!paused)
+		if (!paused && !settings.simulationThread)
 		{
 			timer += timerSpeed * frameTimer;
 			if (timer > 1.0)
@@ -357,14 +478,35 @@ void VulkanExampleBase::renderLoop()
 		if (prepared)
 		{
 			auto tStart = std::chrono::high_resolution_clock::now();
-			render();
+			if (settings.simulationThread)
+			{
+				consumeSimulationState();
+			}
+			{
+				VKS_TRACE_ZONE("render");
+				render();
+			}
 			frameCounter++;
 			auto tEnd = std::chrono::high_resolution_clock::now();
 			auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 			frameTimer = tDiff / 1000.0f;
-			camera.update(frameTimer);
+			if (benchmark.active)
+			{
+				benchmark.addFrame(tDiff);
+				if (benchmark.finished())
+				{
+					// Leave the loop as on a destroy request, the results are saved once the device is idle
+					ANativeActivity_finish(androidApp->activity);
+					break;
+				}
+			}
+			if (!settings.simulationThread)
+			{
+				VKS_TRACE_ZONE("camera.update");
+				camera.update(frameTimer);
+			}
 			// Convert to clamped timer value
-			if (!paused)
+			if (!paused && !settings.simulationThread)
 			{
 				timer += timerSpeed * frameTimer;
 				if (timer > 1.0)
@@ -389,6 +531,7 @@ void VulkanExampleBase::renderLoop()
 			}
 			if (touchTimer >= 1.0) {
 				camera.keys.up = true;
+				VKS_TRACE_ZONE("viewChanged");
 				viewChanged();
 			}
 
@@ -419,6 +562,7 @@ void VulkanExampleBase::renderLoop()
 				}
 				if (updateView)
 				{
+					VKS_TRACE_ZONE("viewChanged");
 					viewChanged();
 				}
 			}
@@ -427,6 +571,7 @@ void VulkanExampleBase::renderLoop()
 				updateView = camera.updatePad(gamePadState.axisLeft, gamePadState.axisRight, frameTimer);
 				if (updateView)
 				{
+					VKS_TRACE_ZONE("viewChanged");
 					viewChanged();
 				}
 			}
@@ -436,23 +581,43 @@ void VulkanExampleBase::renderLoop()
 	while (!quit)
 	{
 		auto tStart = std::chrono::high_resolution_clock::now();
+		if (settings.simulationThread)
+		{
+			consumeSimulationState();
+		}
 		if (viewUpdated)
 		{
 			viewUpdated = false;
+			VKS_TRACE_ZONE("viewChanged");
 			viewChanged();
 		}
-		render();
+		{
+			VKS_TRACE_ZONE("render");
+			render();
+		}
 		frameCounter++;
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 		frameTimer = tDiff / 1000.0f;
-		camera.update(frameTimer);
+		if (benchmark.active)
+		{
+			benchmark.addFrame(tDiff);
+			if (benchmark.finished())
+			{
+				quit = true;
+			}
+		}
+		if (!settings.simulationThread)
+		{
+			VKS_TRACE_ZONE("camera.update");
+			camera.update(frameTimer);
+		}
 		if (camera.moving())
 		{
 			viewUpdated = true;
 		}
 		// Convert to clamped timer value
-		if (!paused)
+		if (!paused && !settings.simulationThread)
 		{
 			timer += timerSpeed * frameTimer;
 			if (timer > 1.0)
@@ -473,9 +638,14 @@ void VulkanExampleBase::renderLoop()
 	while (!quit)
 	{
 		auto tStart = std::chrono::high_resolution_clock::now();
+		if (settings.simulationThread)
+		{
+			consumeSimulationState();
+		}
 		if (viewUpdated)
 		{
 			viewUpdated = false;
+			VKS_TRACE_ZONE("viewChanged");
 			viewChanged();
 		}
 
@@ -485,18 +655,33 @@ void VulkanExampleBase::renderLoop()
 		wl_display_read_events(display);
 		wl_display_dispatch_pending(display);
 
-		render();
+		{
+			VKS_TRACE_ZONE("render");
+			render();
+		}
 		frameCounter++;
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 		frameTimer = tDiff / 1000.0f;
-		camera.update(frameTimer);
+		if (benchmark.active)
+		{
+			benchmark.addFrame(tDiff);
+			if (benchmark.finished())
+			{
+				quit = true;
+			}
+		}
+		if (!settings.simulationThread)
+		{
+			VKS_TRACE_ZONE("camera.update");
+			camera.update(frameTimer);
+		}
 		if (camera.moving())
 		{
 			viewUpdated = true;
 		}
 		// Convert to clamped timer value
-		if (!paused)
+		if (!paused && !settings.simulationThread)
 		{
 			timer += timerSpeed * frameTimer;
 			if (timer > 1.0)
@@ -523,9 +708,14 @@ void VulkanExampleBase::renderLoop()
 	while (!quit)
 	{
 		auto tStart = std::chrono::high_resolution_clock::now();
+		if (settings.simulationThread)
+		{
+			consumeSimulationState();
+		}
         if (viewUpdated)
         {
             viewUpdated = false;
+            VKS_TRACE_ZONE("viewChanged");
             viewChanged();
         }
 		xcb_generic_event_t *event;
@@ -534,14 +724,25 @@ void VulkanExampleBase::renderLoop()
 			handleEvent(event);
 			free(event);
 		}
-		render();
+		{
+			VKS_TRACE_ZONE("render");
+			render();
+		}
 		frameCounter++;
 		auto tEnd = std::chrono::high_resolution_clock::now();
 		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
 		frameTimer = tDiff / 1000.0f;
+		if (benchmark.active)
+		{
+			benchmark.addFrame(tDiff);
+			if (benchmark.finished())
+			{
+				quit = true;
+			}
+		}
 
 		// Convert to clamped timer value
-		if (!paused)
+		if (!paused && !settings.simulationThread)
 		{
 			timer += timerSpeed * frameTimer;            
 			if (timer > 1.0)
@@ -567,8 +768,311 @@ void VulkanExampleBase::renderLoop()
 		}
 	}
 #endif
+	stopSimulation();
 	// Flush device to make sure all resources can be freed 
 	vkDeviceWaitIdle(device);
+	finishBenchmark();
+}
+
+void VulkanExampleBase::renderLoopHeadless()
+{
+	// Same frame flow as the windowed loops, without event handling
+	uint32_t framesRendered = 0;
+	while (!quit && ((settings.frameLimit == 0) || (framesRendered < settings.frameLimit)))
+	{
+		auto tStart = std::chrono::high_resolution_clock::now();
+		if (settings.simulationThread)
+		{
+			consumeSimulationState();
+		}
+		if (viewUpdated)
+		{
+			viewUpdated = false;
+			VKS_TRACE_ZONE("viewChanged");
+			viewChanged();
+		}
+		{
+			VKS_TRACE_ZONE("render");
+			render();
+		}
+		frameCounter++;
+		framesRendered++;
+		auto tEnd = std::chrono::high_resolution_clock::now();
+		auto tDiff = std::chrono::duration<double, std::milli>(tEnd - tStart).count();
+		frameTimer = (float)tDiff / 1000.0f;
+		if (benchmark.active)
+		{
+			benchmark.addFrame(tDiff);
+			if (benchmark.finished())
+			{
+				quit = true;
+			}
+		}
+
+		// Convert to clamped timer value
+		if (!paused && !settings.simulationThread)
+		{
+			timer += timerSpeed * frameTimer;
+			if (timer > 1.0)
+			{
+				update();
+				timer -= 1.0f;
+			}
+		}
+		fpsTimer += (float)tDiff;
+		if (fpsTimer > 1000.0f)
+		{
+			lastFPS = frameCounter;
+			updateTextOverlay();
+			fpsTimer = 0.0f;
+			frameCounter = 0;
+		}
+	}
+	// Flush device to make sure all resources can be freed and the last readback is complete
+	vkDeviceWaitIdle(device);
+	finishBenchmark();
+
+	if (!settings.readbackFile.empty())
+	{
+		if (!swapChain.saveReadback(currentBuffer, settings.readbackFile))
+		{
+			std::cerr << "Could not write last frame to " << settings.readbackFile << std::endl;
+		}
+	}
+}
+
+void VulkanExampleBase::startSimulation()
+{
+	simulationCamera = camera;
+	simulationTimer = timer;
+	renderedCamera = { camera.position, camera.rotation, timer, 0, 0 };
+	simulationStates[0] = simulationStates[1] = renderedCamera;
+	simulationInput = SimulationInput();
+	simulationInput.keys = camera.keys;
+	simulationInput.paused = paused;
+	latestTickTime = std::chrono::steady_clock::now();
+	simulationRunning = true;
+	simulationThread = std::thread(&VulkanExampleBase::simulationLoop, this);
+}
+
+void VulkanExampleBase::stopSimulation()
+{
+	simulationRunning = false;
+	if (simulationThread.joinable())
+	{
+		simulationThread.join();
+	}
+}
+
+void VulkanExampleBase::simulationLoop()
+{
+	vks::trace::setThreadName("Simulation");
+	const float tickTime = 1.0f / (float)settings.tickRate;
+	const auto tickDuration = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(tickTime));
+	auto nextTick = std::chrono::steady_clock::now();
+	uint64_t timerWraps = 0;
+	while (simulationRunning)
+	{
+		VKS_TRACE_ZONE("Simulation tick");
+		bool tickPaused;
+		{
+			// Apply the input forwarded by the render thread since the last tick
+			std::lock_guard<std::mutex> lock(simulationMutex);
+			simulationCamera.keys = simulationInput.keys;
+			simulationCamera.rotate(simulationInput.rotation);
+			simulationCamera.translate(simulationInput.translation);
+			simulationInput.rotation = glm::vec3(0.0f);
+			simulationInput.translation = glm::vec3(0.0f);
+			tickPaused = simulationInput.paused;
+		}
+
+		// Fixed time step, independent of how long frames take to render
+		simulationCamera.update(tickTime);
+		if (!tickPaused)
+		{
+			simulationTimer += timerSpeed * tickTime;
+			if (simulationTimer > 1.0)
+			{
+				simulationTimer -= 1.0f;
+				timerWraps++;
+			}
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(simulationMutex);
+			simulationStates[0] = simulationStates[1];
+			simulationStates[1] = { simulationCamera.position, simulationCamera.rotation, simulationTimer, simulationStates[0].tick + 1, timerWraps };
+			latestTickTime = std::chrono::steady_clock::now();
+		}
+
+		nextTick += tickDuration;
+		auto now = std::chrono::steady_clock::now();
+		if (now > nextTick + tickDuration * 4)
+		{
+			// Too far behind (e.g. after a breakpoint), skip the missed ticks instead of catching up
+			nextTick = now;
+		}
+		std::this_thread::sleep_until(nextTick);
+	}
+}
+
+void VulkanExampleBase::consumeSimulationState()
+{
+	SimulationState previous, latest;
+	std::chrono::steady_clock::time_point tickTime;
+	{
+		std::lock_guard<std::mutex> lock(simulationMutex);
+		// Input handlers change the render camera directly, forward their changes to the simulation
+		simulationInput.rotation += camera.rotation - renderedCamera.rotation;
+		simulationInput.translation += camera.position - renderedCamera.position;
+		simulationInput.keys = camera.keys;
+		simulationInput.paused = paused;
+		previous = simulationStates[0];
+		latest = simulationStates[1];
+		tickTime = latestTickTime;
+	}
+
+	// Render between the last two ticks, one tick behind the simulation
+	float alpha = std::chrono::duration<float>(std::chrono::steady_clock::now() - tickTime).count() * (float)settings.tickRate;
+	alpha = glm::clamp(alpha, 0.0f, 1.0f);
+	glm::vec3 position = glm::mix(previous.position, latest.position, alpha);
+	glm::vec3 rotation = glm::mix(previous.rotation, latest.rotation, alpha);
+	timer = (latest.timer >= previous.timer) ? glm::mix(previous.timer, latest.timer, alpha) : latest.timer;
+
+	if ((position != renderedCamera.position) || (rotation != renderedCamera.rotation))
+	{
+		camera.setPosition(position);
+		camera.setRotation(rotation);
+		viewUpdated = true;
+	}
+	// Derived class state is only touched on the render thread, at the cadence of the non threaded loop
+	if (latest.timerWraps != renderedCamera.timerWraps)
+	{
+		update();
+	}
+	renderedCamera = { camera.position, camera.rotation, timer, latest.tick, latest.timerWraps };
+}
+
+void VulkanExampleBase::setupFrameTimestamps()
+{
+	if (!benchmark.active)
+	{
+		return;
+	}
+	timestampValidBits = vulkanDevice->queueFamilyProperties[vulkanDevice->queueFamilyIndices.graphics].timestampValidBits;
+	if ((timestampValidBits == 0) || (deviceProperties.limits.timestampPeriod <= 0.0f))
+	{
+		std::cout << "Timestamps are not supported by the graphics queue, gpu frame times are not measured" << std::endl;
+		return;
+	}
+
+	// Two queries per frame slot, written at the start and the end of the slot's queue work
+	VkQueryPoolCreateInfo queryPoolCI = {};
+	queryPoolCI.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+	queryPoolCI.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	queryPoolCI.queryCount = settings.framesInFlight * 2;
+	VK_CHECK_RESULT(vkCreateQueryPool(device, &queryPoolCI, nullptr, &timestampQueryPool));
+
+	// The command buffers only write timestamps and are recorded once
+	timestampCmdBuffers.resize(settings.framesInFlight * 2);
+	VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(timestampCmdBuffers.size()));
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, timestampCmdBuffers.data()));
+	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+	for (uint32_t slot = 0; slot < settings.framesInFlight; slot++)
+	{
+		VkCommandBuffer beginCmd = timestampCmdBuffers[slot * 2];
+		VK_CHECK_RESULT(vkBeginCommandBuffer(beginCmd, &cmdBufInfo));
+		vkCmdResetQueryPool(beginCmd, timestampQueryPool, slot * 2, 2);
+		vkCmdWriteTimestamp(beginCmd, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, timestampQueryPool, slot * 2);
+		VK_CHECK_RESULT(vkEndCommandBuffer(beginCmd));
+
+		VkCommandBuffer endCmd = timestampCmdBuffers[slot * 2 + 1];
+		VK_CHECK_RESULT(vkBeginCommandBuffer(endCmd, &cmdBufInfo));
+		vkCmdWriteTimestamp(endCmd, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, timestampQueryPool, slot * 2 + 1);
+		VK_CHECK_RESULT(vkEndCommandBuffer(endCmd));
+	}
+	timestampFrames.resize(settings.framesInFlight, -1);
+
+	timestampSemaphores.resize(settings.framesInFlight);
+	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
+	for (auto &semaphore : timestampSemaphores)
+	{
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore));
+	}
+}
+
+void VulkanExampleBase::submitFrameTimestamp(bool end)
+{
+	VkSubmitInfo timestampSubmitInfo = vks::initializers::submitInfo();
+	timestampSubmitInfo.commandBufferCount = 1;
+	timestampSubmitInfo.pCommandBuffers = &timestampCmdBuffers[frameIndex * 2 + (end ? 1 : 0)];
+	// The start timestamp waits for the acquired image, so the wait for presentation is not measured
+	VkPipelineStageFlags waitStageMask = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+	if (!end)
+	{
+		timestampSubmitInfo.waitSemaphoreCount = 1;
+		timestampSubmitInfo.pWaitSemaphores = &frameSemaphores[frameIndex].presentComplete;
+		timestampSubmitInfo.pWaitDstStageMask = &waitStageMask;
+		timestampSubmitInfo.signalSemaphoreCount = 1;
+		timestampSubmitInfo.pSignalSemaphores = &timestampSemaphores[frameIndex];
+	}
+	VK_CHECK_RESULT(vulkanDevice->queueSubmit(queue, 1, &timestampSubmitInfo, VK_NULL_HANDLE));
+}
+
+void VulkanExampleBase::readFrameTimestamps(uint32_t slot)
+{
+	if ((timestampQueryPool == VK_NULL_HANDLE) || (timestampFrames[slot] < 0))
+	{
+		return;
+	}
+	// The slot's frame has finished executing, so the results are available without waiting
+	uint64_t timestamps[2];
+	VkResult result = vkGetQueryPoolResults(device, timestampQueryPool, slot * 2, 2, sizeof(timestamps), timestamps, sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result == VK_SUCCESS)
+	{
+		uint64_t mask = (timestampValidBits >= 64) ? ~0ULL : ((1ULL << timestampValidBits) - 1);
+		// Work of the previous frame may still execute after this frame's start timestamp, only count the time after it ended
+		uint64_t begin = timestamps[0];
+		if (((lastFrameEndTimestamp - begin) & mask) < ((timestamps[1] - begin) & mask))
+		{
+			begin = lastFrameEndTimestamp;
+		}
+		lastFrameEndTimestamp = timestamps[1];
+		double ticks = (double)((timestamps[1] - begin) & mask);
+		benchmark.setGpuTime(timestampFrames[slot], ticks * deviceProperties.limits.timestampPeriod / 1000000.0);
+	}
+	timestampFrames[slot] = -1;
+}
+
+void VulkanExampleBase::finishBenchmark()
+{
+	if (!benchmark.active)
+	{
+		return;
+	}
+	// Called with the device idle, all outstanding timestamps can be read, oldest frame first
+	for (uint32_t i = 0; i < timestampFrames.size(); i++)
+	{
+		readFrameTimestamps((frameIndex + i) % static_cast<uint32_t>(timestampFrames.size()));
+	}
+	benchmark.save();
+}
+
+static const char* presentModeName(VkPresentModeKHR presentMode)
+{
+	switch (presentMode)
+	{
+	case VK_PRESENT_MODE_IMMEDIATE_KHR:
+		return "IMMEDIATE";
+	case VK_PRESENT_MODE_MAILBOX_KHR:
+		return "MAILBOX";
+	case VK_PRESENT_MODE_FIFO_KHR:
+		return "FIFO";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+		return "FIFO_RELAXED";
+	default:
+		return "UNKNOWN";
+	}
 }
 
 void VulkanExampleBase::updateTextOverlay()
@@ -576,6 +1080,7 @@ void VulkanExampleBase::updateTextOverlay()
 	if (!enableTextOverlay)
 		return;
 
+	VKS_TRACE_ZONE("updateTextOverlay");
 	textOverlay->beginTextUpdate();
 
 	textOverlay->addText(title, 5.0f, 5.0f, VulkanTextOverlay::alignLeft);
@@ -593,6 +1098,26 @@ void VulkanExampleBase::updateTextOverlay()
 #endif
 	textOverlay->addText(deviceName, 5.0f, 45.0f, VulkanTextOverlay::alignLeft);
 
+	float y = 65.0f;
+	if (!settings.headless)
+	{
+		std::stringstream presentText;
+		presentText << std::fixed << std::setprecision(1) << presentModeName(swapChain.presentMode) << ", " << swapChain.imageCount << " images, input latency " << averageInputLatency << "ms";
+		textOverlay->addText(presentText.str(), 5.0f, y, VulkanTextOverlay::alignLeft);
+		y += 20.0f;
+	}
+
+	if (vulkanDevice->profiler)
+	{
+		for (auto &scope : vulkanDevice->profiler->getScopes())
+		{
+			std::stringstream scopeText;
+			scopeText << std::fixed << std::setprecision(3) << scope.name << ": " << scope.average() << "ms (max " << scope.max() << "ms)";
+			textOverlay->addText(scopeText.str(), 5.0f, y, VulkanTextOverlay::alignLeft);
+			y += 20.0f;
+		}
+	}
+
 	getOverlayText(textOverlay);
 
 	textOverlay->endTextUpdate();
@@ -600,56 +1125,160 @@ void VulkanExampleBase::updateTextOverlay()
 
 void VulkanExampleBase::getOverlayText(VulkanTextOverlay*) {}
 
+bool VulkanExampleBase::drawsTextOverlay() const
+{
+	return enableTextOverlay && !textOverlayInRenderPass;
+}
+
+void VulkanExampleBase::buildTextOverlayCommandBuffers()
+{
+	if (!drawsTextOverlay())
+	{
+		return;
+	}
+
+	// One command buffer per swap chain image, the text itself is updated through the overlay's vertex regions
+	textOverlayCmdBuffers.resize(swapChain.imageCount);
+	VkCommandBufferAllocateInfo cmdBufAllocateInfo = vks::initializers::commandBufferAllocateInfo(cmdPool, VK_COMMAND_BUFFER_LEVEL_PRIMARY, static_cast<uint32_t>(textOverlayCmdBuffers.size()));
+	VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &cmdBufAllocateInfo, textOverlayCmdBuffers.data()));
+
+	VkCommandBufferBeginInfo cmdBufInfo = vks::initializers::commandBufferBeginInfo();
+	for (uint32_t i = 0; i < textOverlayCmdBuffers.size(); i++)
+	{
+		VK_CHECK_RESULT(vkBeginCommandBuffer(textOverlayCmdBuffers[i], &cmdBufInfo));
+		textOverlay->drawRenderPass(textOverlayCmdBuffers[i], frameBuffers[i], i);
+		VK_CHECK_RESULT(vkEndCommandBuffer(textOverlayCmdBuffers[i]));
+	}
+}
+
 void VulkanExampleBase::prepareFrame()
 {
+	VKS_TRACE_ZONE("prepareFrame");
+	// Wait for the frame that used this slot before, its semaphores and per frame resources can then be reused
+	vulkanDevice->waitForFrame(frameSerials[frameIndex]);
+	// Per frame slot resources of the device's users (e.g. model group instance buffers) are written now that the slot is free
+	vulkanDevice->beginFrame(frameIndex);
+	if (timestampQueryPool != VK_NULL_HANDLE)
+	{
+		readFrameTimestamps(frameIndex);
+	}
+	semaphores = frameSemaphores[frameIndex];
+	submitInfo.pWaitSemaphores = &semaphores.presentComplete;
+	submitInfo.pSignalSemaphores = &semaphores.renderComplete;
+	// Release resources retired by frames that have finished executing
+	vulkanDevice->updateCompletedFrames();
+	resolveInputLatency();
+	// Input received since the last frame is attributed to this one
+	frameInputPending[frameIndex] = inputPending;
+	frameInputTimes[frameIndex] = pendingInputTime;
+	inputPending = false;
+	// Submit uploads recorded since the last frame so they execute ahead of this frame's command buffers
+	if (vulkanDevice->stagingRing)
+	{
+		vulkanDevice->stagingRing->submit();
+		vulkanDevice->stagingRing->reclaim();
+	}
+	// Asynchronous uploads run on the transfer queue alongside the frame
+	if (vulkanDevice->transferRing)
+	{
+		vulkanDevice->transferRing->submit();
+		vulkanDevice->transferRing->reclaim();
+	}
+	// Refresh heap budgets so the allocator's budget callback sees memory used by other processes
+	vulkanDevice->updateMemoryBudget();
 	// Acquire the next image from the swap chain
 	VkResult err = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
-	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) or no longer optimal for presentation (SUBOPTIMAL)
-	if ((err == VK_ERROR_OUT_OF_DATE_KHR) || (err == VK_SUBOPTIMAL_KHR)) {
+	// Recreate the swapchain if it's no longer compatible with the surface (OUT_OF_DATE) and acquire from the new one,
+	// the semaphore has not been signaled so it can be reused
+	if (err == VK_ERROR_OUT_OF_DATE_KHR) {
 		windowResize();
+		err = swapChain.acquireNextImage(semaphores.presentComplete, &currentBuffer);
+	}
+	// A suboptimal image can still be presented, the swapchain is recreated after this frame
+	if (err == VK_SUBOPTIMAL_KHR) {
+		swapChainSuboptimal = true;
 	}
 	else {
 		VK_CHECK_RESULT(err);
 	}
+	// Benchmark gpu time starts once the acquired image is available, the frame's command buffers wait for the start timestamp instead
+	if (timestampQueryPool != VK_NULL_HANDLE)
+	{
+		submitFrameTimestamp(false);
+		semaphores.presentComplete = timestampSemaphores[frameIndex];
+	}
+	// The command buffers of the acquired image may still be executing for an older frame in another slot
+	if (currentBuffer < imageSerials.size())
+	{
+		vulkanDevice->waitForFrame(imageSerials[currentBuffer]);
+	}
+	// Re-record the acquired image's command buffer if the state it has been recorded with was invalidated
+	// Versions are taken before recording, state changed while recording (e.g. per frame secondaries) makes the buffer stale again
+	std::vector<uint64_t> stateVersions = commandBufferStateVersions();
+	if ((currentBuffer < drawCmdBufferVersions.size()) && (drawCmdBufferVersions[currentBuffer] != stateVersions))
+	{
+		VKS_TRACE_ZONE("Re-record command buffer");
+		if (buildCommandBuffer(currentBuffer))
+		{
+			drawCmdBufferVersions[currentBuffer] = stateVersions;
+		}
+		else
+		{
+			rebuildCommandBuffers();
+		}
+	}
+	// Resolve the profiler scopes of the image's previous frame and reset its queries
+	if (vulkanDevice->profiler)
+	{
+		vulkanDevice->profiler->beginFrame(queue, currentBuffer);
+	}
+	// Bring the overlay text of the acquired image up to date, its previous frame has finished
+	if (enableTextOverlay)
+	{
+		textOverlay->prepareImage(currentBuffer);
+	}
 }
 
 void VulkanExampleBase::submitFrame()
 {
-	bool submitTextOverlay = enableTextOverlay && textOverlay->visible;
-
-	if (submitTextOverlay)
+	VKS_TRACE_ZONE("submitFrame");
+	if (timestampQueryPool != VK_NULL_HANDLE)
 	{
-		// Wait for color attachment output to finish before rendering the text overlay
-		VkPipelineStageFlags stageFlags = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		submitInfo.pWaitDstStageMask = &stageFlags;
-
-		// Set semaphores
-		// Wait for render complete semaphore
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = &semaphores.renderComplete;
-		// Signal ready with text overlay complete semaphpre
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = &semaphores.textOverlayComplete;
+		submitFrameTimestamp(true);
+		timestampFrames[frameIndex] = benchmark.currentFrame();
+	}
 
-		// Submit current text overlay command buffer
-		submitInfo.commandBufferCount = 1;
-		submitInfo.pCommandBuffers = &textOverlay->cmdBuffers[currentBuffer];
-		VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	uint32_t presentID = ++presentCount;
+	VkResult err = swapChain.queuePresent(queue, currentBuffer, semaphores.renderComplete, presentID);
+	if ((err == VK_ERROR_OUT_OF_DATE_KHR) || (err == VK_SUBOPTIMAL_KHR)) {
+		swapChainSuboptimal = true;
+	}
+	else {
+		VK_CHECK_RESULT(err);
+	}
 
-		// Reset stage mask
-		submitInfo.pWaitDstStageMask = &submitPipelineStages;
-		// Reset wait and signal semaphores for rendering next frame
-		// Wait for swap chain presentation to finish
-		submitInfo.waitSemaphoreCount = 1;
-		submitInfo.pWaitSemaphores = &semaphores.presentComplete;
-		// Signal ready with offscreen semaphore
-		submitInfo.signalSemaphoreCount = 1;
-		submitInfo.pSignalSemaphores = &semaphores.renderComplete;
+	// Signal the end of this frame's work so resources retired during the frame can be released once it has completed
+	uint64_t serial = vulkanDevice->endFrame(queue);
+	frameSerials[frameIndex] = serial;
+	if (frameInputPending[frameIndex])
+	{
+		latencySamples.push_back({ presentID, serial, frameInputTimes[frameIndex] });
 	}
+	if (currentBuffer >= imageSerials.size())
+	{
+		imageSerials.resize(currentBuffer + 1, 0);
+	}
+	imageSerials[currentBuffer] = serial;
 
-	VK_CHECK_RESULT(swapChain.queuePresent(queue, currentBuffer, submitTextOverlay ? semaphores.textOverlayComplete : semaphores.renderComplete));
+	// Move on to the next frame slot, the device is only waited for when that slot is reused
+	frameIndex = (frameIndex + 1) % settings.framesInFlight;
 
-	VK_CHECK_RESULT(vkQueueWaitIdle(queue));
+	// Recreate a swapchain that no longer matches the surface now that the frame has been handed off
+	if (swapChainSuboptimal)
+	{
+		swapChainSuboptimal = false;
+		windowResize();
+	}
 }
 
 VulkanExampleBase::VulkanExampleBase(bool enableValidation)
@@ -657,6 +1286,7 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 	settings.validation = enableValidation;
 
 	// Parse command line arguments
+	bool benchmarkDurationSet = false;
 	for (size_t i = 0; i < args.size(); i++)
 	{
 		if (args[i] == std::string("-validation"))
@@ -671,6 +1301,84 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 		{
 			settings.fullscreen = true;
 		}
+		if (args[i] == std::string("-headless"))
+		{
+			settings.headless = true;
+		}
+		if ((args[i] == std::string("-frames")) && (i + 1 < args.size()))
+		{
+			char* endptr;
+			uint32_t frames = strtol(args[i + 1], &endptr, 10);
+			if (endptr != args[i + 1]) { settings.frameLimit = frames; };
+		}
+		if ((args[i] == std::string("-readback")) && (i + 1 < args.size()))
+		{
+			settings.readbackFile = args[i + 1];
+		}
+		if ((args[i] == std::string("-trace")) && (i + 1 < args.size()))
+		{
+			settings.traceFile = args[i + 1];
+		}
+		if ((args[i] == std::string("-framesinflight")) && (i + 1 < args.size()))
+		{
+			char* endptr;
+			uint32_t frames = strtol(args[i + 1], &endptr, 10);
+			if ((endptr != args[i + 1]) && (frames > 0)) { settings.framesInFlight = frames; };
+		}
+		if ((args[i] == std::string("-presentmode")) && (i + 1 < args.size()))
+		{
+			std::string mode(args[i + 1]);
+			if (mode == "immediate") { settings.presentMode = VK_PRESENT_MODE_IMMEDIATE_KHR; };
+			if (mode == "mailbox") { settings.presentMode = VK_PRESENT_MODE_MAILBOX_KHR; };
+			if (mode == "fifo") { settings.presentMode = VK_PRESENT_MODE_FIFO_KHR; };
+			if (mode == "fiforelaxed") { settings.presentMode = VK_PRESENT_MODE_FIFO_RELAXED_KHR; };
+		}
+		if ((args[i] == std::string("-swapimages")) && (i + 1 < args.size()))
+		{
+			char* endptr;
+			uint32_t images = strtol(args[i + 1], &endptr, 10);
+			if (endptr != args[i + 1]) { settings.swapchainImages = images; };
+		}
+		if (args[i] == std::string("-simthread"))
+		{
+			settings.simulationThread = true;
+		}
+		if ((args[i] == std::string("-tickrate")) && (i + 1 < args.size()))
+		{
+			char* endptr;
+			uint32_t rate = strtol(args[i + 1], &endptr, 10);
+			if ((endptr != args[i + 1]) && (rate > 0)) { settings.tickRate = rate; };
+		}
+		if (args[i] == std::string("-profile"))
+		{
+			settings.profiler = true;
+		}
+		if (args[i] == std::string("-benchmark"))
+		{
+			benchmark.active = true;
+		}
+		if ((args[i] == std::string("-bwarmup")) && (i + 1 < args.size()))
+		{
+			char* endptr;
+			uint32_t frames = strtol(args[i + 1], &endptr, 10);
+			if (endptr != args[i + 1]) { benchmark.warmupFrames = frames; };
+		}
+		if ((args[i] == std::string("-bframes")) && (i + 1 < args.size()))
+		{
+			char* endptr;
+			uint32_t frames = strtol(args[i + 1], &endptr, 10);
+			if (endptr != args[i + 1]) { benchmark.frameCount = frames; };
+		}
+		if ((args[i] == std::string("-bduration")) && (i + 1 < args.size()))
+		{
+			char* endptr;
+			double seconds = strtod(args[i + 1], &endptr);
+			if (endptr != args[i + 1]) { benchmark.duration = seconds; benchmarkDurationSet = true; };
+		}
+		if ((args[i] == std::string("-boutput")) && (i + 1 < args.size()))
+		{
+			benchmark.filename = args[i + 1];
+		}
 		if ((args[i] == std::string("-w")) || (args[i] == std::string("-width")))
 		{
 			char* endptr;
@@ -684,6 +1392,17 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 			if (endptr != args[i + 1]) { height = h; };
 		}
 	}
+	// A frame count alone limits the benchmark to that many frames
+	if ((benchmark.frameCount > 0) && !benchmarkDurationSet)
+	{
+		benchmark.duration = 0.0;
+	}
+	// Started before anything is loaded so asset loading shows up in the trace
+	if (!settings.traceFile.empty())
+	{
+		vks::trace::enable();
+		vks::trace::setThreadName("Main");
+	}
 	
 #if defined(__ANDROID__)
 	// Vulkan library is loaded dynamically on Android
@@ -692,9 +1411,15 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 #elif defined(_DIRECT2DISPLAY)
 
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	initWaylandConnection();
+	if (!settings.headless)
+	{
+		initWaylandConnection();
+	}
 #elif defined(__linux__)
-	initxcbConnection();
+	if (!settings.headless)
+	{
+		initxcbConnection();
+	}
 #endif
 
 #if defined(_WIN32)
@@ -709,6 +1434,16 @@ VulkanExampleBase::VulkanExampleBase(bool enableValidation)
 
 VulkanExampleBase::~VulkanExampleBase()
 {
+	// Derived classes have been destroyed, so no other thread is recording zones anymore
+	if (!settings.traceFile.empty() && !vks::trace::write(settings.traceFile))
+	{
+		std::cerr << "Could not write trace to " << settings.traceFile << std::endl;
+	}
+
+	// Swap chains and frame buffers retired on resize must be destroyed before the surface
+	vkDeviceWaitIdle(device);
+	vulkanDevice->releaseRetired();
+
 	// Clean up Vulkan resources
 	swapChain.cleanup();
 	if (descriptorPool != VK_NULL_HANDLE)
@@ -728,21 +1463,33 @@ VulkanExampleBase::~VulkanExampleBase()
 	}
 	vkDestroyImageView(device, depthStencil.view, nullptr);
 	vkDestroyImage(device, depthStencil.image, nullptr);
-	vkFreeMemory(device, depthStencil.mem, nullptr);
+	vulkanDevice->freeMemory(depthStencil.allocation);
 
 	vkDestroyPipelineCache(device, pipelineCache, nullptr);
 
 	vkDestroyCommandPool(device, cmdPool, nullptr);
+	if (timestampQueryPool != VK_NULL_HANDLE)
+	{
+		vkDestroyQueryPool(device, timestampQueryPool, nullptr);
+	}
+	for (auto &semaphore : timestampSemaphores)
+	{
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
 
-	vkDestroySemaphore(device, semaphores.presentComplete, nullptr);
-	vkDestroySemaphore(device, semaphores.renderComplete, nullptr);
-	vkDestroySemaphore(device, semaphores.textOverlayComplete, nullptr);
+	for (auto &frame : frameSemaphores)
+	{
+		vkDestroySemaphore(device, frame.presentComplete, nullptr);
+		vkDestroySemaphore(device, frame.renderComplete, nullptr);
+	}
 
 	if (enableTextOverlay)
 	{
+		vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(textOverlayCmdBuffers.size()), textOverlayCmdBuffers.data());
 		delete textOverlay;
 	}
 
+	delete vulkanDevice->profiler;
 	delete vulkanDevice;
 
 	if (settings.validation)
@@ -755,23 +1502,29 @@ VulkanExampleBase::~VulkanExampleBase()
 #if defined(_DIRECT2DISPLAY)
 
 #elif defined(VK_USE_PLATFORM_WAYLAND_KHR)
-	wl_shell_surface_destroy(shell_surface);
-	wl_surface_destroy(surface);
-	if (keyboard)
-		wl_keyboard_destroy(keyboard);
-	if (pointer)
-		wl_pointer_destroy(pointer);
-	wl_seat_destroy(seat);
-	wl_shell_destroy(shell);
-	wl_compositor_destroy(compositor);
-	wl_registry_destroy(registry);
-	wl_display_disconnect(display);
+	if (!settings.headless)
+	{
+		wl_shell_surface_destroy(shell_surface);
+		wl_surface_destroy(surface);
+		if (keyboard)
+			wl_keyboard_destroy(keyboard);
+		if (pointer)
+			wl_pointer_destroy(pointer);
+		wl_seat_destroy(seat);
+		wl_shell_destroy(shell);
+		wl_compositor_destroy(compositor);
+		wl_registry_destroy(registry);
+		wl_display_disconnect(display);
+	}
 #elif defined(__linux)
 #if defined(__ANDROID__)
 	// todo : android cleanup (if required)
 #else
-	xcb_destroy_window(connection, window);
-	xcb_disconnect(connection);
+	if (!settings.headless)
+	{
+		xcb_destroy_window(connection, window);
+		xcb_disconnect(connection);
+	}
 #endif
 #endif
 }
@@ -884,7 +1637,17 @@ void VulkanExampleBase::initVulkan()
 	// This is handled by a separate class that gets a logical device representation
 	// and encapsulates functions related to a device
 	vulkanDevice = new vks::VulkanDevice(physicalDevice);
-	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledExtensions);
+	vulkanDevice->getPhysicalDeviceMemoryProperties2 = reinterpret_cast<PFN_vkGetPhysicalDeviceMemoryProperties2KHR>(vkGetInstanceProcAddr(instance, "vkGetPhysicalDeviceMemoryProperties2KHR"));
+#if defined(__linux__)
+	// Actual presentation times are used for the input latency, their clock matches steady_clock on Linux and Android
+	if (!settings.headless && vulkanDevice->extensionSupported(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME))
+	{
+		enabledExtensions.push_back(VK_GOOGLE_DISPLAY_TIMING_EXTENSION_NAME);
+		swapChain.displayTiming = true;
+	}
+#endif
+	// No swapchain extension is required for headless rendering
+	VkResult res = vulkanDevice->createLogicalDevice(enabledFeatures, enabledExtensions, !settings.headless);
 	if (res != VK_SUCCESS) {
 		vks::tools::exitFatal("Could not create Vulkan device: \n" + vks::tools::errorString(res), "Fatal error");
 	}
@@ -897,20 +1660,36 @@ void VulkanExampleBase::initVulkan()
 	VkBool32 validDepthFormat = vks::tools::getSupportedDepthFormat(physicalDevice, &depthFormat);
 	assert(validDepthFormat);
 
+	swapChain.headless = settings.headless;
 	swapChain.connect(instance, physicalDevice, device);
-
-	// Create synchronization objects
+	// Loader threads may submit uploads to the graphics queue, presents take the same lock
+	swapChain.queueMutex = &vulkanDevice->queueMutex(queue);
+	// Swap chains replaced on resize are destroyed once the frames presenting them have finished
+	swapChain.deferDestruction = [this](std::function<void()> release) { vulkanDevice->retire(release); };
+	// Offscreen images of headless mode are sub-allocated like the other attachments
+	swapChain.memoryAllocator = vulkanDevice->memoryAllocator;
+
+	// Create synchronization objects, one set per frame slot
+	if (settings.framesInFlight == 0)
+	{
+		settings.framesInFlight = 1;
+	}
+	vulkanDevice->framesInFlight = settings.framesInFlight;
+	frameSemaphores.resize(settings.framesInFlight);
+	frameSerials.resize(settings.framesInFlight, 0);
+	frameInputPending.resize(settings.framesInFlight, false);
+	frameInputTimes.resize(settings.framesInFlight);
 	VkSemaphoreCreateInfo semaphoreCreateInfo = vks::initializers::semaphoreCreateInfo();
-	// Create a semaphore used to synchronize image presentation
-	// Ensures that the image is displayed before we start submitting new commands to the queu
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.presentComplete));
-	// Create a semaphore used to synchronize command submission
-	// Ensures that the image is not presented until all commands have been sumbitted and executed
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.renderComplete));
-	// Create a semaphore used to synchronize command submission
-	// Ensures that the image is not presented until all commands for the text overlay have been sumbitted and executed
-	// Will be inserted after the render complete semaphore if the text overlay is enabled
-	VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphores.textOverlayComplete));
+	for (auto &frame : frameSemaphores)
+	{
+		// Create a semaphore used to synchronize image presentation
+		// Ensures that the image is displayed before we start submitting new commands to the queu
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.presentComplete));
+		// Create a semaphore used to synchronize command submission
+		// Ensures that the image is not presented until all commands have been sumbitted and executed
+		VK_CHECK_RESULT(vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &frame.renderComplete));
+	}
+	semaphores = frameSemaphores[0];
 
 	// Set up submit info structure
 	// Semaphores will stay the same during application lifetime
@@ -954,6 +1733,11 @@ HWND VulkanExampleBase::setupWindow(HINSTANCE hinstance, WNDPROC wndproc)
 {
 	this->windowInstance = hinstance;
 
+	if (settings.headless)
+	{
+		return nullptr;
+	}
+
 	WNDCLASSEX wndClass;
 
 	wndClass.cbSize = sizeof(WNDCLASSEX);
@@ -1078,6 +1862,7 @@ void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPAR
 		ValidateRect(window, NULL);
 		break;
 	case WM_KEYDOWN:
+		recordInput();
 		switch (wParam)
 		{
 		case KEY_P:
@@ -1089,6 +1874,9 @@ void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPAR
 				textOverlay->visible = !textOverlay->visible;
 			}
 			break;
+		case KEY_F3:
+			cyclePresentMode();
+			break;
 		case KEY_ESCAPE:
 			PostQuitMessage(0);
 			break;
@@ -1138,11 +1926,13 @@ void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPAR
 	case WM_RBUTTONDOWN:
 	case WM_LBUTTONDOWN:
 	case WM_MBUTTONDOWN:
+		recordInput();
 		mousePos.x = (float)LOWORD(lParam);
 		mousePos.y = (float)HIWORD(lParam);
 		break;
 	case WM_MOUSEWHEEL:
 	{
+		recordInput();
 		short wheelDelta = GET_WHEEL_DELTA_WPARAM(wParam);
 		zoom += (float)wheelDelta * 0.005f * zoomSpeed;
 		camera.translate(glm::vec3(0.0f, 0.0f, (float)wheelDelta * 0.005f * zoomSpeed));
@@ -1150,6 +1940,7 @@ void VulkanExampleBase::handleMessages(HWND hWnd, UINT uMsg, WPARAM wParam, LPAR
 		break;
 	}
 	case WM_MOUSEMOVE:
+		recordInput();
 		if (wParam & MK_RBUTTON)
 		{
 			int32_t posx = LOWORD(lParam);
@@ -1359,6 +2150,9 @@ void VulkanExampleBase::handleAppCommand(android_app * app, int32_t cmd)
 	case APP_CMD_TERM_WINDOW:
 		// Window is hidden or closed, clean up resources
 		LOGD("APP_CMD_TERM_WINDOW");
+		// Swap chains retired on resize must be destroyed before the surface
+		vkDeviceWaitIdle(vulkanExample->device);
+		vulkanExample->vulkanDevice->releaseRetired();
 		vulkanExample->swapChain.cleanup();
 		break;
 	}
@@ -1406,6 +2200,7 @@ void* VulkanExampleBase::setupWindow(void* view)
 void VulkanExampleBase::pointerMotion(wl_pointer *pointer, uint32_t time,
 		wl_fixed_t sx, wl_fixed_t sy)
 {
+	recordInput();
 	double x = wl_fixed_to_double(sx);
 	double y = wl_fixed_to_double(sy);
 
@@ -1449,6 +2244,7 @@ void VulkanExampleBase::pointerMotion(wl_pointer *pointer, uint32_t time,
 void VulkanExampleBase::pointerButton(struct wl_pointer *pointer,
 		uint32_t serial, uint32_t time, uint32_t button, uint32_t state)
 {
+	recordInput();
 	switch (button)
 	{
 	case BTN_LEFT:
@@ -1476,6 +2272,7 @@ void VulkanExampleBase::pointerButton(struct wl_pointer *pointer,
 void VulkanExampleBase::pointerAxis(wl_pointer *pointer, uint32_t time,
 		uint32_t axis, wl_fixed_t value)
 {
+	recordInput();
 	double d = wl_fixed_to_double(value);
 	switch (axis)
 	{
@@ -1517,6 +2314,7 @@ void VulkanExampleBase::pointerAxis(wl_pointer *pointer, uint32_t time,
 void VulkanExampleBase::keyboardKey(struct wl_keyboard *keyboard,
 		uint32_t serial, uint32_t time, uint32_t key, uint32_t state)
 {
+	recordInput();
 	switch (key)
 	{
 	case KEY_W:
@@ -1539,6 +2337,10 @@ void VulkanExampleBase::keyboardKey(struct wl_keyboard *keyboard,
 		if (state && enableTextOverlay)
 			textOverlay->visible = !textOverlay->visible;
 		break;
+	case KEY_F3:
+		if (state)
+			cyclePresentMode();
+		break;
 	case KEY_ESC:
 		quit = true;
 		break;
@@ -1662,6 +2464,10 @@ static void PopupDoneCb(void *data, struct wl_shell_surface *shell_surface)
 
 wl_shell_surface *VulkanExampleBase::setupWindow()
 {
+	if (settings.headless)
+	{
+		return nullptr;
+	}
 	surface = wl_compositor_create_surface(compositor);
 	shell_surface = wl_shell_get_shell_surface(shell, surface);
 
@@ -1688,6 +2494,11 @@ xcb_window_t VulkanExampleBase::setupWindow()
 {
 	uint32_t value_mask, value_list[32];
 
+	if (settings.headless)
+	{
+		return 0;
+	}
+
 	window = xcb_generate_id(connection);
 
 	value_mask = XCB_CW_BACK_PIXEL | XCB_CW_EVENT_MASK;
@@ -1786,6 +2597,7 @@ void VulkanExampleBase::handleEvent(const xcb_generic_event_t *event)
         float diffY = mousePos.y - (float)motion->event_y;
         if (diffX==0&&diffY==0)
             break;
+        recordInput();
         mousePos = glm::vec2((float)motion->event_x, (float)motion->event_y);
 
         if (mouseButtons.left)
@@ -1809,6 +2621,7 @@ void VulkanExampleBase::handleEvent(const xcb_generic_event_t *event)
     break;
 	case XCB_BUTTON_PRESS:
     {
+		recordInput();
 		xcb_button_press_event_t *press = (xcb_button_press_event_t *)event;
 		if (press->detail == XCB_BUTTON_INDEX_1)
 			mouseButtons.left = true;
@@ -1833,6 +2646,7 @@ void VulkanExampleBase::handleEvent(const xcb_generic_event_t *event)
 	break;
 	case XCB_KEY_PRESS:
 	{
+		recordInput();
 		const xcb_key_release_event_t *keyEvent = (const xcb_key_release_event_t *)event;
 		switch (keyEvent->detail)
 		{
@@ -1845,6 +2659,9 @@ void VulkanExampleBase::handleEvent(const xcb_generic_event_t *event)
 					textOverlay->visible = !textOverlay->visible;
 				}
 				break;				
+			case KEY_F3:
+				cyclePresentMode();
+				break;
 		}
 	}
 	break;	
@@ -1893,6 +2710,45 @@ void VulkanExampleBase::mouseMove(float, float) {}
 
 void VulkanExampleBase::buildCommandBuffers() {}
 
+bool VulkanExampleBase::buildCommandBuffer(uint32_t)
+{
+	return false;
+}
+
+void VulkanExampleBase::invalidateCommandBuffers()
+{
+	commandBufferVersion++;
+}
+
+void VulkanExampleBase::addCommandBufferDependency(std::function<uint64_t()> version)
+{
+	commandBufferDependencies.push_back(version);
+}
+
+std::vector<uint64_t> VulkanExampleBase::commandBufferStateVersions() const
+{
+	std::vector<uint64_t> versions;
+	versions.reserve(commandBufferDependencies.size() + 1);
+	versions.push_back(commandBufferVersion);
+	for (auto &dependency : commandBufferDependencies)
+	{
+		versions.push_back(dependency());
+	}
+	return versions;
+}
+
+void VulkanExampleBase::rebuildCommandBuffers()
+{
+	// All command buffers are recorded at once, none of them may still be executing
+	for (auto serial : imageSerials)
+	{
+		vulkanDevice->waitForFrame(serial);
+	}
+	std::vector<uint64_t> stateVersions = commandBufferStateVersions();
+	buildCommandBuffers();
+	drawCmdBufferVersions.assign(drawCmdBuffers.size(), stateVersions);
+}
+
 void VulkanExampleBase::createCommandPool()
 {
 	VkCommandPoolCreateInfo cmdPoolInfo = {};
@@ -1917,12 +2773,6 @@ void VulkanExampleBase::setupDepthStencil()
 	image.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
 	image.flags = 0;
 
-	VkMemoryAllocateInfo mem_alloc = {};
-	mem_alloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	mem_alloc.pNext = NULL;
-	mem_alloc.allocationSize = 0;
-	mem_alloc.memoryTypeIndex = 0;
-
 	VkImageViewCreateInfo depthStencilView = {};
 	depthStencilView.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
 	depthStencilView.pNext = NULL;
@@ -1936,14 +2786,9 @@ void VulkanExampleBase::setupDepthStencil()
 	depthStencilView.subresourceRange.baseArrayLayer = 0;
 	depthStencilView.subresourceRange.layerCount = 1;
 
-	VkMemoryRequirements memReqs;
-
 	VK_CHECK_RESULT(vkCreateImage(device, &image, nullptr, &depthStencil.image));
-	vkGetImageMemoryRequirements(device, depthStencil.image, &memReqs);
-	mem_alloc.allocationSize = memReqs.size;
-	mem_alloc.memoryTypeIndex = vulkanDevice->getMemoryType(memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	VK_CHECK_RESULT(vkAllocateMemory(device, &mem_alloc, nullptr, &depthStencil.mem));
-	VK_CHECK_RESULT(vkBindImageMemory(device, depthStencil.image, depthStencil.mem, 0));
+	VK_CHECK_RESULT(vulkanDevice->allocateImageMemory(depthStencil.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, &depthStencil.allocation, VK_IMAGE_TILING_OPTIMAL, vks::MemoryCategory::Attachment));
+	depthStencil.mem = depthStencil.allocation.memory;
 
 	depthStencilView.image = depthStencil.image;
 	VK_CHECK_RESULT(vkCreateImageView(device, &depthStencilView, nullptr, &depthStencil.view));
@@ -1986,7 +2831,7 @@ void VulkanExampleBase::setupRenderPass()
 	attachments[0].stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
 	attachments[0].stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
 	attachments[0].initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-	attachments[0].finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+	attachments[0].finalLayout = swapChain.presentLayout;
 	// Depth attachment
 	attachments[1].format = depthFormat;
 	attachments[1].samples = VK_SAMPLE_COUNT_1_BIT;
@@ -2060,41 +2905,65 @@ void VulkanExampleBase::windowResize()
 	}
 	prepared = false;
 
-	// Ensure all operations on the device have been finished before destroying resources
-	vkDeviceWaitIdle(device);
+	// The device is not drained: frames in flight keep rendering to the old swap chain, depth stencil and frame buffers,
+	// which are retired to the device and destroyed once those frames have finished
 
-	// Recreate swap chain
+	// Recreate swap chain, the old one is passed to the new one and retired
 	width = destWidth;
 	height = destHeight;
 	setupSwapChain();
 
-	// Recreate the frame buffers
-
-	vkDestroyImageView(device, depthStencil.view, nullptr);
-	vkDestroyImage(device, depthStencil.image, nullptr);
-	vkFreeMemory(device, depthStencil.mem, nullptr);
-	setupDepthStencil();
-	
-	for (uint32_t i = 0; i < frameBuffers.size(); i++)
+	// Recreate the size dependent attachments and frame buffers
+	std::vector<VkFramebuffer> oldFrameBuffers = frameBuffers;
+	vulkanDevice->retire([this, oldFrameBuffers]()
 	{
-		vkDestroyFramebuffer(device, frameBuffers[i], nullptr);
-	}
+		for (auto frameBuffer : oldFrameBuffers)
+		{
+			vkDestroyFramebuffer(device, frameBuffer, nullptr);
+		}
+	});
+	vulkanDevice->retireImageView(depthStencil.view);
+	vulkanDevice->retireImage(depthStencil.image);
+	vulkanDevice->retireAllocation(depthStencil.allocation);
+	setupDepthStencil();
 	setupFrameBuffer();
 
-	// Command buffers need to be recreated as they may store
-	// references to the recreated frame buffer
-	destroyCommandBuffers();
-	createCommandBuffers();
-	buildCommandBuffers();
-
-	vkDeviceWaitIdle(device);
+	// Profiler queries are kept per swap chain image as well
+	if (vulkanDevice->profiler)
+	{
+		vulkanDevice->profiler->resize(swapChain.imageCount);
+	}
 
+	// The overlay keeps a vertex region per swap chain image, resized before the command buffers drawing it are rebuilt
 	if (enableTextOverlay)
 	{
-		textOverlay->reallocateCommandBuffers();
+		textOverlay->resize(static_cast<uint32_t>(frameBuffers.size()));
 		updateTextOverlay();
+		std::vector<VkCommandBuffer> oldOverlayCmdBuffers = textOverlayCmdBuffers;
+		if (!oldOverlayCmdBuffers.empty())
+		{
+			vulkanDevice->retire([this, oldOverlayCmdBuffers]()
+			{
+				vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(oldOverlayCmdBuffers.size()), oldOverlayCmdBuffers.data());
+			});
+		}
+		buildTextOverlayCommandBuffers();
 	}
 
+	// Command buffers need to be recreated as they may store
+	// references to the recreated frame buffer, the old ones may still be executing
+	std::vector<VkCommandBuffer> oldCmdBuffers = drawCmdBuffers;
+	vulkanDevice->retire([this, oldCmdBuffers]()
+	{
+		vkFreeCommandBuffers(device, cmdPool, static_cast<uint32_t>(oldCmdBuffers.size()), oldCmdBuffers.data());
+	});
+	createCommandBuffers();
+	buildCommandBuffers();
+
+	// Images of the new swap chain reuse the overlay regions of the old images with the same index,
+	// so the last frames using those indices are still waited for on acquire
+	imageSerials.resize(swapChain.imageCount, 0);
+
 	// Notify derived class
 	windowResized();
 	viewChanged();
@@ -2109,6 +2978,12 @@ void VulkanExampleBase::windowResized()
 
 void VulkanExampleBase::initSwapchain()
 {
+	if (settings.headless)
+	{
+		swapChain.readback = !settings.readbackFile.empty();
+		swapChain.initHeadless(queue, vulkanDevice->queueFamilyIndices.graphics);
+		return;
+	}
 #if defined(_WIN32)
 	swapChain.initSurface(windowInstance, window);
 #elif defined(__ANDROID__)	
@@ -2126,5 +3001,85 @@ void VulkanExampleBase::initSwapchain()
 
 void VulkanExampleBase::setupSwapChain()
 {
+	swapChain.requestedPresentMode = settings.presentMode;
+	swapChain.requestedImageCount = settings.swapchainImages;
 	swapChain.create(&width, &height, settings.vsync);
 }
+
+void VulkanExampleBase::setPresentMode(VkPresentModeKHR presentMode, uint32_t imageCount)
+{
+	settings.presentMode = presentMode;
+	settings.swapchainImages = imageCount;
+	// Recreated like on a resize, at the current size
+	destWidth = width;
+	destHeight = height;
+	windowResize();
+	updateTextOverlay();
+}
+
+void VulkanExampleBase::cyclePresentMode()
+{
+	const std::vector<VkPresentModeKHR> &modes = swapChain.supportedPresentModes;
+	if (modes.empty())
+	{
+		return;
+	}
+	auto current = std::find(modes.begin(), modes.end(), swapChain.presentMode);
+	auto next = ((current == modes.end()) || (current + 1 == modes.end())) ? modes.begin() : current + 1;
+	setPresentMode(*next, settings.swapchainImages);
+}
+
+void VulkanExampleBase::recordInput()
+{
+	// Latency is measured from the oldest input not yet picked up by a frame
+	if (!inputPending)
+	{
+		inputPending = true;
+		pendingInputTime = std::chrono::steady_clock::now();
+	}
+}
+
+void VulkanExampleBase::resolveInputLatency()
+{
+	std::vector<VkPastPresentationTimingGOOGLE> timings;
+	if (swapChain.getPastPresentationTimings(timings))
+	{
+		for (auto &timing : timings)
+		{
+			// Presents older than a reported one were never displayed (e.g. replaced in mailbox mode)
+			while (!latencySamples.empty() && (latencySamples.front().presentID <= timing.presentID))
+			{
+				if (latencySamples.front().presentID == timing.presentID)
+				{
+					uint64_t inputTime = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(latencySamples.front().inputTime.time_since_epoch()).count();
+					if (timing.actualPresentTime > inputTime)
+					{
+						addInputLatency((float)((double)(timing.actualPresentTime - inputTime) / 1000000.0));
+					}
+				}
+				latencySamples.pop_front();
+			}
+		}
+	}
+	else
+	{
+		// Without presentation timing, the frame's completion on the device is the closest available point
+		auto now = std::chrono::steady_clock::now();
+		while (!latencySamples.empty() && (latencySamples.front().serial <= vulkanDevice->completedFrameSerial))
+		{
+			addInputLatency(std::chrono::duration<float, std::milli>(now - latencySamples.front().inputTime).count());
+			latencySamples.pop_front();
+		}
+	}
+	// Never reported presents must not pile up
+	while (latencySamples.size() > 64)
+	{
+		latencySamples.pop_front();
+	}
+}
+
+void VulkanExampleBase::addInputLatency(float latency)
+{
+	inputLatency = latency;
+	averageInputLatency = (averageInputLatency == 0.0f) ? latency : averageInputLatency * 0.9f + latency * 0.1f;
+}
@@ -29,6 +29,10 @@
 
 #include <iostream>
 #include <chrono>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <deque>
 #include <sys/stat.h>
 
 #define GLM_FORCE_RADIANS
@@ -50,6 +54,8 @@
 #include "VulkanSwapChain.hpp"
 #include "VulkanTextOverlay.hpp"
 #include "camera.hpp"
+#include "benchmark.hpp"
+#include "trace.hpp"
 
 class VulkanExampleBase
 {
@@ -64,6 +70,63 @@ private:
     bool resizing = false;
     // Called if the window is resized and some resources have to be recreatesd
     void windowResize();
+
+    // Simulation thread (see settings.simulationThread)
+    struct SimulationState {
+        glm::vec3 position;
+        glm::vec3 rotation;
+        float timer;
+        uint64_t tick;
+        // Number of times the timer has wrapped, update() is called on the render thread when it advances
+        uint64_t timerWraps;
+    };
+    // Input made on the render thread since the last tick, applied by the simulation thread
+    struct SimulationInput {
+        glm::vec3 rotation = glm::vec3(0.0f);
+        glm::vec3 translation = glm::vec3(0.0f);
+        decltype(Camera::keys) keys;
+        bool paused = false;
+    };
+    std::thread simulationThread;
+    std::atomic<bool> simulationRunning{ false };
+    std::mutex simulationMutex;
+    // Previous and latest published tick, the render thread interpolates between them
+    SimulationState simulationStates[2];
+    std::chrono::steady_clock::time_point latestTickTime;
+    SimulationInput simulationInput;
+    // Simulation thread's own camera and timer
+    Camera simulationCamera;
+    float simulationTimer = 0.0f;
+    // State last applied to the render camera
+    SimulationState renderedCamera;
+    void startSimulation();
+    void stopSimulation();
+    void simulationLoop();
+    // Forward input to the simulation and apply the interpolated state to the camera and timer
+    void consumeSimulationState();
+
+    // Input latency (see recordInput)
+    struct LatencySample {
+        uint32_t presentID;
+        uint64_t serial;
+        std::chrono::steady_clock::time_point inputTime;
+    };
+    bool inputPending = false;
+    std::chrono::steady_clock::time_point pendingInputTime;
+    // Input picked up by the frame prepared in each slot
+    std::vector<bool> frameInputPending;
+    std::vector<std::chrono::steady_clock::time_point> frameInputTimes;
+    // Presented frames that picked up input, waiting for their presentation time
+    std::deque<LatencySample> latencySamples;
+    uint32_t presentCount = 0;
+    void resolveInputLatency();
+    void addInputLatency(float latency);
+    // Switch to the next present mode supported by the surface (F3)
+    void cyclePresentMode();
+    // Text overlay drawn by the base after the frame's command buffers in the same submission (see submitDrawCommandBuffers and textOverlayInRenderPass)
+    std::vector<VkCommandBuffer> textOverlayCmdBuffers;
+    bool drawsTextOverlay() const;
+    void buildTextOverlayCommandBuffers();
 protected:
     /** brief Indicates that the view (position, rotation) has changed and */
     bool viewUpdated = false;
@@ -93,6 +156,7 @@ protected:
     // todo: getter? should always point to VulkanDevice->device
     VkDevice device;
     // Handle to the device graphics queue that command buffers are submitted to
+    // Submit through queueSubmit or submitDrawCommandBuffers, loader threads may submit uploads to the same queue
     VkQueue queue;
     // Depth buffer format (selected during Vulkan initialization)
     VkFormat depthFormat;
@@ -104,6 +168,14 @@ protected:
     VkSubmitInfo submitInfo;
     // Command buffers used for rendering
     std::vector<VkCommandBuffer> drawCmdBuffers;
+    /** @brief Version of the state the draw command buffers depend on that has no version of its own (e.g. pipelines), advanced by invalidateCommandBuffers */
+    uint64_t commandBufferVersion = 0;
+    /** @brief Versions of other state the draw command buffers are recorded with, e.g. model group instances (see addCommandBufferDependency) */
+    std::vector<std::function<uint64_t()>> commandBufferDependencies;
+    /** @brief Versions each draw command buffer has been recorded with (commandBufferVersion, then one per dependency), stale ones are re-recorded before their image is used */
+    std::vector<std::vector<uint64_t>> drawCmdBufferVersions;
+    // Current value of commandBufferVersion and of each dependency
+    std::vector<uint64_t> commandBufferStateVersions() const;
     // Global render pass for frame buffer writes
     VkRenderPass renderPass;
     // List of available frame buffers (same as number of swap chain images)
@@ -119,14 +191,39 @@ protected:
     // Wraps the swap chain to present images (framebuffers) to the windowing system
     VulkanSwapChain swapChain;
     // Synchronization semaphores
-    struct {
+    struct FrameSemaphores {
         // Swap chain image presentation
         VkSemaphore presentComplete;
         // Command buffer submission and execution
         VkSemaphore renderComplete;
-        // Text overlay submission and execution
-        VkSemaphore textOverlayComplete;
-    } semaphores;
+    };
+    /** @brief Semaphores of the frame slot being prepared, set by prepareFrame (submitInfo points to them) */
+    FrameSemaphores semaphores;
+    /** @brief Semaphores per frame slot */
+    std::vector<FrameSemaphores> frameSemaphores;
+    /** @brief Frame slot being prepared, in [0, settings.framesInFlight), resources written by the cpu each frame should be indexed by it */
+    uint32_t frameIndex = 0;
+    /** @brief Device frame serial last submitted per frame slot, waited for before the slot is reused */
+    std::vector<uint64_t> frameSerials;
+    /** @brief Device frame serial last rendering to each swap chain image */
+    std::vector<uint64_t> imageSerials;
+    /** @brief Set when acquire or present report a swap chain that no longer matches the surface, recreated after the frame is submitted */
+    bool swapChainSuboptimal = false;
+    /** @brief Timestamps written at the start and end of each frame slot's queue work (benchmark mode only) */
+    VkQueryPool timestampQueryPool = VK_NULL_HANDLE;
+    /** @brief Pre-recorded command buffers writing the start and end timestamp of each frame slot */
+    std::vector<VkCommandBuffer> timestampCmdBuffers;
+    /** @brief Signaled by each frame slot's start timestamp, which takes over the wait for the acquired image from the frame's command buffers */
+    std::vector<VkSemaphore> timestampSemaphores;
+    /** @brief End timestamp of the last frame read back, the next frame's gpu time starts no earlier than this */
+    uint64_t lastFrameEndTimestamp = 0;
+    /** @brief Benchmark frame measured by each frame slot's timestamps, -1 if none */
+    std::vector<int64_t> timestampFrames;
+    uint32_t timestampValidBits = 0;
+    void setupFrameTimestamps();
+    void submitFrameTimestamp(bool end);
+    void readFrameTimestamps(uint32_t slot);
+    void finishBenchmark();
 public:
     bool prepared = false;
     uint32_t width = 1280;
@@ -135,6 +232,19 @@ public:
 
     /** @brief Last frame time measured using a high performance timer (if available) */
     float frameTimer = 1.0f;
+    /** @brief Time from the last input event picked up by a frame to that frame's presentation in milliseconds (to its completion on the device if VK_GOOGLE_display_timing is not available) */
+    float inputLatency = 0.0f;
+    /** @brief Moving average of inputLatency */
+    float averageInputLatency = 0.0f;
+    /** @brief Timestamp an input event, called by the platform event handlers (derived classes handling their own input may call it too) */
+    void recordInput();
+    /**
+    * Recreate the swapchain with another present mode and image count
+    *
+    * @param presentMode Present mode to use, falls back to FIFO if the surface does not support it
+    * @param imageCount Minimum number of swapchain images, 0 for the surface minimum plus one
+    */
+    void setPresentMode(VkPresentModeKHR presentMode, uint32_t imageCount = 0);
     /** @brief Returns os specific base asset path (for shaders, models, textures) */
     const std::string getAssetPath();
 
@@ -149,8 +259,34 @@ public:
         bool fullscreen = false;
         /** @brief Set to true if v-sync will be forced for the swapchain */
         bool vsync = false;
+        /** @brief Present mode of the swapchain, VK_PRESENT_MODE_MAX_ENUM_KHR selects one based on vsync (-presentmode immediate|mailbox|fifo|fiforelaxed) */
+        VkPresentModeKHR presentMode = VK_PRESENT_MODE_MAX_ENUM_KHR;
+        /** @brief Minimum number of swapchain images, 0 for the surface minimum plus one (-swapimages N) */
+        uint32_t swapchainImages = 0;
+        /** @brief Number of frames the cpu may prepare while previous ones are still executing (must be set before initVulkan) */
+        uint32_t framesInFlight = 2;
+        /** @brief Render to offscreen images without a window or surface (e.g. for benchmarking on build machines without a display) */
+        bool headless = false;
+        /** @brief Number of frames rendered before the render loop exits in headless mode, 0 runs until quit is set */
+        uint32_t frameLimit = 0;
+        /** @brief PPM file the last rendered image is written to when the headless render loop exits (no readback if empty) */
+        std::string readbackFile;
+        /** @brief Measure the named scopes of the frame command buffers with timestamps and show them in the text overlay */
+        bool profiler = false;
+        /**
+        * @brief Run camera movement and the animation timer on a separate thread at a fixed tick rate, the render loop interpolates between the last two ticks (-simthread)
+        * @note update() stays on the render thread and is still called when the animation timer wraps, so derived class state needs no synchronization
+        */
+        bool simulationThread = false;
+        /** @brief Simulation ticks per second when simulationThread is set (-tickrate N) */
+        uint32_t tickRate = 60;
+        /** @brief Chrome trace event file the cpu zones are written to on exit, zones are only recorded if set (-trace file.json) */
+        std::string traceFile;
     } settings;
 
+    /** @brief Records cpu and gpu frame times when enabled with -benchmark (see -bwarmup, -bframes, -bduration and -boutput) */
+    vks::Benchmark benchmark;
+
     VkClearColorValue defaultClearColor = { { 0.025f, 0.025f, 0.025f, 1.0f } };
 
     float zoom = 0;
@@ -165,7 +301,13 @@ public:
 
     bool paused = false;
 
+    /** @brief Draw the text overlay, by default appended to the command buffers submitted with submitDrawCommandBuffers */
     bool enableTextOverlay = false;
+    /**
+    * @brief Set by derived classes that draw the overlay in their own render pass with textOverlay->draw(drawCmdBuffers[i], i)
+    * @note Saves the extra render pass the base otherwise uses to draw the overlay
+    */
+    bool textOverlayInRenderPass = false;
     VulkanTextOverlay *textOverlay;
 
     // Use to adjust mouse rotation speed
@@ -193,6 +335,7 @@ public:
     {
         VkImage image;
         VkDeviceMemory mem;
+        vks::Allocation allocation;
         VkImageView view;
     } depthStencil;
 
@@ -327,6 +470,7 @@ public:
     virtual VkResult createInstance(bool enableValidation);
 
     //update frame
+    // Called on the render thread each time the animation timer wraps (also with settings.simulationThread)
     virtual void update() = 0;
     // Pure virtual render function (override in derived class)
     virtual void render() = 0;
@@ -344,11 +488,26 @@ public:
 
     // Called when the window has been resized
     // Can be overriden in derived class to recreate or rebuild resources attached to the frame buffer / swapchain
+    // The device is not idle, replaced resources have to be handed to vulkanDevice->retire instead of being destroyed
     virtual void windowResized();
     // Pure virtual function to be overriden by the dervice class
     // Called in case of an event where e.g. the framebuffer has to be rebuild and thus
     // all command buffers that may reference this
+    // Don't call it directly while frames are in flight, the command buffers may still be executing:
+    // use invalidateCommandBuffers to have them re-recorded lazily, or rebuildCommandBuffers to re-record them right away
     virtual void buildCommandBuffers();
+    // Record the command buffer of a single swap chain image, called right before the image is used if its command buffer is stale
+    // Can be overriden in derived class, return false (default) to have all command buffers rebuilt with buildCommandBuffers instead
+    virtual bool buildCommandBuffer(uint32_t imageIndex);
+    // Mark all draw command buffers as stale after a change to the state they are recorded with
+    // They are re-recorded lazily, each one right before its swap chain image is next used
+    // Framebuffers are handled by the base, the text overlay draws a fixed quad count and needs no re-recording
+    void invalidateCommandBuffers();
+    // Track the version of state the draw command buffers are recorded with, e.g. vks::ModelGroup::commandBufferVersion or vks::GrowableBuffer::version
+    // A command buffer recorded with an older value is re-recorded lazily, no explicit invalidation is needed
+    void addCommandBufferDependency(std::function<uint64_t()> version);
+    // Wait for all frames using the draw command buffers and re-record them with buildCommandBuffers
+    void rebuildCommandBuffers();
 
     // Creates a new (graphics) command pool object storing command buffers
     void createCommandPool();
@@ -384,6 +543,16 @@ public:
     // Note : Waits for the queue to become idle
     void flushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue, bool free);
 
+    // Submit to the graphics queue while holding its lock (see vulkanDevice->queueSubmit)
+    VkResult queueSubmit(uint32_t submitCount, const VkSubmitInfo *submits, VkFence fence = VK_NULL_HANDLE);
+    // Submit the frame's command buffers to the graphics queue between prepareFrame and submitFrame
+    // Waits for the acquired image and signals the semaphore presentation waits for, like submitInfo
+    // Also waits for the asynchronous uploads the command buffers acquired (see vks::UploadToken::acquire)
+    // The text overlay drawn by the base is appended to the command buffers, derived classes drawing it must submit through this
+    void submitDrawCommandBuffers(uint32_t commandBufferCount, const VkCommandBuffer *commandBuffers, VkFence fence = VK_NULL_HANDLE);
+    // Submit the draw command buffer of the acquired image (drawCmdBuffers[currentBuffer])
+    void submitDrawCommandBuffer();
+
     // Create a cache pool for rendering pipelines
     void createPipelineCache();
 
@@ -396,6 +565,9 @@ public:
     // Start the main render loop
     void renderLoop();
 
+    // Render loop used in headless mode, runs until quit is set or settings.frameLimit frames have been rendered
+    void renderLoopHeadless();
+
     // Render one frame of a render loop on platforms that sync rendering
     void renderFrame();
 
@@ -405,12 +577,14 @@ public:
     virtual void getOverlayText(VulkanTextOverlay*);
 
     // Prepare the frame for workload submission
+    // - Waits for the frame that last used the current frame slot
     // - Acquires the next image from the swap chain
     // - Sets the default wait and signal semaphores
     void prepareFrame();
 
     // Submit the frames' workload
-    // - Submits the text overlay (if enabled)
+    // - Presents the current image
+    // - Advances frameIndex to the next frame slot, without waiting for the device
     void submitFrame();
 
 };